@@ -0,0 +1,835 @@
+//Title: NonogramBenchmark.cpp
+//Description: Times the solver on a set of puzzle files
+//so that the different ways of checking a stripe can be
+//compared against each other, puzzle by puzzle.
+//With -lines, times check() on single long stripes instead.
+//-nomirror leaves out the grid's column-major copy, to see what it costs.
+//"-cache n" gives each solve a line cache of n megabytes of its own (see
+//NonogramLineCache.h) and reports the share of checks played back from it.
+//With -suite, generates random puzzles from 10x10 up to 2000x2000
+//(see NonogramGenerator.h) and reports, for each size, puzzles per
+//second, microseconds per check and peak memory, as tab-separated
+//lines on cout or in the file given with -results. The puzzles are
+//the same every time, so the results of two runs can be compared.
+//-generate writes one such puzzle to cout instead.
+//With -guesses, solves generated puzzles that need a lot of guessing,
+//once with search() and once with a search that throws and catches
+//every contradiction at the level of propagate(). The rules underneath
+//return their status either way, so that is a single throw for each
+//contradiction, not the unwinding through the rules the solver used
+//to do: what the exceptions cost, at the least.
+//With -search, solves the same puzzles with searchBoard(), and then with
+//the parallel search (see NonogramParallelSearch.h) on 1, 2, 4 and so on
+//up to "-threads n" threads (one per core by default), and reports for
+//each the time, the guesses a second, the steals, and the share of the
+//threads' time spent waiting for work.
+//With -unique, checks generated puzzles for a unique solution (see
+//countSolutions in NonogramSearch.h), with and without probing, and
+//reports puzzles per second and how many turned out to have only one.
+//With -order, solves each puzzle file (guessing if it has to) with the
+//stripes checked in turn and then by priority (see WorkQueue), and
+//reports the checks, the checks the old round-robin order would have
+//made on top of those, the guesses and the time for each.
+//With -formats, writes solved generated puzzles over and over in each
+//picture format (see NonogramOutput.h), and the way printToFile used to,
+//a character at a time, and reports bytes and microseconds per picture.
+//With -masks, runs the exact line solver and the mask solver (see
+//NonogramMaskSolver.h) on the same random lines of up to 128 cells,
+//reports any line they don't agree on, and times them.
+//Built with -DNONOGRAM_RULE_STATS, it also writes the counts for each
+//logical step (see NonogramRuleStats.h) to cerr at the end.
+//Usage: NonogramBenchmark [-repeat n] [-nomirror] [-cache n] puzzle1.txt puzzle2.txt ...
+//       NonogramBenchmark [-repeat n] -lines
+//       NonogramBenchmark -suite [-mode rules|final|exact] [-density d]
+//          [-maxsize n] [-nomirror] [-results file]
+//       NonogramBenchmark -guesses [-repeat n] [-mode rules|final|exact]
+//       NonogramBenchmark -search [-threads n] [-repeat n] [-mode rules|final|exact]
+//       NonogramBenchmark -unique [-repeat n] [-mode rules|final|exact]
+//       NonogramBenchmark -order [-repeat n] [-mode rules|final|exact] puzzle1.txt puzzle2.txt ...
+//       NonogramBenchmark -formats [-repeat n]
+//       NonogramBenchmark -masks [-repeat n]
+//       NonogramBenchmark -generate rows columns density seed
+
+#include "NonogramLogic.h"
+#include "NonogramObjects.h"
+#include "NonogramScheduler.h"
+#include "NonogramSearch.h"
+#include "NonogramParallelSearch.h"
+#include "NonogramThreads.h"
+#include "NonogramLoader.h"
+#include "NonogramGenerator.h"
+#include "NonogramLineCache.h"
+#include "NonogramOutput.h"
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <deque>
+#include <chrono>
+#include <cstdlib>
+#include <random>
+#include <sys/resource.h>
+
+using namespace std;
+
+const char *modeNames[] = { "rules", "final", "exact" };
+
+//One stripe's worth of test data: the clues of a random line,
+//and about a third of its cells given away, so that the rules
+//have something to work with.
+struct TestLine
+{
+   vector<int> clues;
+   vector<char> given;
+};
+
+TestLine makeTestLine(int length, mt19937 &random)
+{
+   TestLine line;
+   int run = 0;
+   for(int i = 0; i < length; i++)
+   {
+      bool dark = random() % 2 == 0;
+      if(dark)
+         run++;
+      if((!dark || i == length - 1) && run > 0)
+      {
+         line.clues.push_back(run);
+         run = 0;
+      }
+      if(random() % 3 == 0)
+         line.given.push_back(dark ? '#' : ' ');
+      else
+         line.given.push_back('-');
+   }
+   return line;
+}
+
+//Times check() on the line, as a row or a column of a grid of its own;
+//through the stripe's virtual methods if "direct" is false, or the way
+//check() itself does it if it is true. A check changes the stripe, so
+//each repetition sets up a batch of copies of the line first and then
+//times checking all of them, enough that even a short line takes long
+//enough to time. Returns microseconds per check.
+template<class Stripe>
+double timeLine(const TestLine &line, bool asRow, bool direct, int repeat)
+{
+   int length = line.given.size();
+   int copies = max(16, 100000 / length);
+   double totalSeconds = 0;
+   for(int rep = 0; rep < repeat; rep++)
+   {
+      //deques, so that each stripe's grid and segments stay where they are
+      deque<GameGrid> grids;
+      deque<Stripe> stripes;
+      deque<vector<Segment> > segments;
+      for(int c = 0; c < copies; c++)
+      {
+         grids.emplace_back(asRow ? 1 : length, asRow ? length : 1);
+         stripes.emplace_back(asRow ? 0 : length, asRow ? length : 0, &grids.back());
+         segments.emplace_back(line.clues.size());
+         for(size_t j = 0; j < line.clues.size(); j++)
+            segments.back()[j].length = line.clues[j];
+         Stripe &stripe = stripes.back();
+         stripe.setSegments(segments.back().data(), segments.back().size());
+         for(int i = 0; i < length; i++)
+         {
+            if(line.given[i] == '#')
+               stripe.fill(i);
+            else if(line.given[i] == ' ')
+               stripe.empty(i);
+         }
+      }
+      chrono::steady_clock::time_point start = chrono::steady_clock::now();
+      for(int c = 0; c < copies; c++)
+      {
+         if(direct)
+            check(&stripes[c]);
+         else
+            checkLine((NonogramStripe*)&stripes[c], RULES_ONLY);
+      }
+      totalSeconds += chrono::duration<double>(chrono::steady_clock::now() - start).count();
+   }
+   return totalSeconds * 1e6 / ((double)repeat * copies);
+}
+
+void benchmarkLines(int repeat)
+{
+   mt19937 random(1);
+   cout << "length\tstripe\tvirtual us/check\tview us/check\tspeedup" << endl;
+   int lengths[] = { 100, 300, 1000, 3000 };
+   for(int l = 0; l < 4; l++)
+   {
+      TestLine line = makeTestLine(lengths[l], random);
+      for(int kind = 0; kind < 2; kind++)
+      {
+         double slow, fast;
+         if(kind == 0)
+         {
+            slow = timeLine<NonogramRow>(line, true, false, repeat);
+            fast = timeLine<NonogramRow>(line, true, true, repeat);
+         }
+         else
+         {
+            slow = timeLine<NonogramColumn>(line, false, false, repeat);
+            fast = timeLine<NonogramColumn>(line, false, true, repeat);
+         }
+         cout << lengths[l] << "\t" << (kind == 0 ? "row" : "column") << "\t" << slow << "\t"
+              << fast << "\t" << slow / fast << endl;
+      }
+   }
+}
+
+//A line with its clues and given cells, as a row or a column of a grid
+//of its own, so that both line solvers can be run on the same thing.
+template<class Stripe>
+struct LineSetup
+{
+   GameGrid grid;
+   Stripe stripe;
+   vector<Segment> segments;
+
+   LineSetup(const TestLine &line, bool asRow) : grid(asRow ? 1 : line.given.size(), asRow ? line.given.size() : 1),
+      stripe(asRow ? 0 : line.given.size(), asRow ? line.given.size() : 0, &grid)
+   {
+      segments.resize(line.clues.size());
+      for(size_t j = 0; j < segments.size(); j++)
+         segments[j].length = line.clues[j];
+      stripe.setSegments(segments.data(), segments.size());
+      for(size_t i = 0; i < line.given.size(); i++)
+      {
+         if(line.given[i] == '#')
+            stripe.fill(i);
+         else if(line.given[i] == ' ')
+            stripe.empty(i);
+      }
+      stripe.changes.clear();
+   }
+};
+
+//Runs solveLine and solveLineMasks on the same line and compares what
+//each did: whether it found a contradiction, the cells it decided and
+//in what order, and the segments' bounds. Adds the time each took.
+template<int MaxWidth, class Stripe>
+bool compareLineSolvers(const TestLine &line, bool asRow, double &slowSeconds, double &fastSeconds, bool &ok)
+{
+   LineSetup<Stripe> slow(line, asRow), fast(line, asRow);
+   StripeView<Stripe> slowView(&slow.stripe), fastView(&fast.stripe);
+   chrono::steady_clock::time_point start = chrono::steady_clock::now();
+   ok = solveLine(&slowView);
+   chrono::steady_clock::time_point middle = chrono::steady_clock::now();
+   bool fastOK = solveLineMasks<MaxWidth>(&fastView);
+   chrono::steady_clock::time_point end = chrono::steady_clock::now();
+   slowSeconds += chrono::duration<double>(middle - start).count();
+   fastSeconds += chrono::duration<double>(end - middle).count();
+   if(ok != fastOK || slow.stripe.changes != fast.stripe.changes)
+      return false;
+   for(int i = 0; i < (int)line.given.size(); i++)
+      if(slow.stripe.cellAt(i) != fast.stripe.cellAt(i))
+         return false;
+   for(size_t j = 0; ok && j < line.clues.size(); j++)
+   {
+      Segment &a = slow.segments[j], &b = fast.segments[j];
+      if(a.minpos != b.minpos || a.maxpos != b.maxpos || a.placed != b.placed)
+         return false;
+   }
+   return true;
+}
+
+//Checks the mask solver against solveLine on random lines of lengths up to
+//128, as rows and as columns, and times both. Half of the lines have one
+//given cell turned around, which often leaves them with no solution.
+template<int MaxWidth>
+void compareLength(int length, int count, mt19937 &random)
+{
+   int mismatches = 0, contradictions = 0;
+   double slowSeconds = 0, fastSeconds = 0;
+   for(int n = 0; n < count; n++)
+   {
+      TestLine line = makeTestLine(length, random);
+      if(n % 2 == 1)
+      {
+         int i = random() % length;
+         if(line.given[i] != '-')
+            line.given[i] = (line.given[i] == '#') ? ' ' : '#';
+      }
+      bool ok, same;
+      if(n % 4 < 2)
+         same = compareLineSolvers<MaxWidth, NonogramRow>(line, true, slowSeconds, fastSeconds, ok);
+      else
+         same = compareLineSolvers<MaxWidth, NonogramColumn>(line, false, slowSeconds, fastSeconds, ok);
+      if(!same)
+         mismatches++;
+      if(!ok)
+         contradictions++;
+   }
+   cout << length << "\t" << count << "\t" << contradictions << "\t" << mismatches << "\t"
+        << slowSeconds * 1e6 / count << "\t" << fastSeconds * 1e6 / count << "\t"
+        << slowSeconds / fastSeconds << endl;
+}
+
+void benchmarkMasks(int repeat)
+{
+   mt19937 random(1);
+   cout << "length\tlines\tno solution\tmismatches\tsolveLine us\tmasks us\tspeedup" << endl;
+   int lengths[] = { 5, 10, 15, 20, 25, 30, 40, 50, 63, 64 };
+   for(int l = 0; l < 10; l++)
+      compareLength<64>(lengths[l], 2000 * repeat, random);
+   int longer[] = { 65, 100, 127, 128 };
+   for(int l = 0; l < 4; l++)
+      compareLength<128>(longer[l], 2000 * repeat, random);
+}
+
+//the most memory this process has used so far, in kilobytes
+long peakMemoryKB()
+{
+   struct rusage usage;
+   getrusage(RUSAGE_SELF, &usage);
+   return usage.ru_maxrss;
+}
+
+//Each size gets fewer puzzles than the one before, so that
+//every size takes roughly as long as the others.
+const int suiteSizes[] = { 10, 25, 50, 100, 200, 500, 1000, 2000 };
+const int suiteCounts[] = { 200, 100, 50, 20, 10, 3, 1, 1 };
+
+//Solves (as far as propagation goes) every generated puzzle of each size.
+//The peak memory only ever goes up, since the sizes go from small to big;
+//it's that of the biggest puzzle so far, plus the program itself.
+void runSuite(CheckMode mode, double density, int maxSize, bool mirror, ostream &out)
+{
+   out << "size\tpuzzles\tdensity\tmode\tsolved\tchecks\tseconds\tpuzzles/s\tus/check\tpeak KB" << endl;
+   for(int c = 0; c < 8 && suiteSizes[c] <= maxSize; c++)
+   {
+      int size = suiteSizes[c], count = suiteCounts[c];
+      int solved = 0;
+      long checks = 0;
+      double totalSeconds = 0;
+      for(int i = 0; i < count; i++)
+      {
+         PuzzleClues clues = generatePuzzle(size, size, density, size * 1000 + i);
+         RowManager allRows;
+         buildPuzzle(clues, allRows, mirror);
+         allRows.mode = mode;
+         chrono::steady_clock::time_point start = chrono::steady_clock::now();
+         initSchedule(allRows);
+         if(propagateStripes(allRows) == PROPAGATE_SOLVED)
+            solved++;
+         totalSeconds += chrono::duration<double>(chrono::steady_clock::now() - start).count();
+         checks += allRows.checkCount;
+         freePuzzle(allRows);
+      }
+      out << size << "x" << size << "\t" << count << "\t" << density << "\t" << modeNames[mode] << "\t"
+          << solved << "\t" << checks << "\t" << totalSeconds << "\t" << count / totalSeconds << "\t"
+          << (checks > 0 ? totalSeconds * 1e6 / checks : 0) << "\t" << peakMemoryKB() << endl;
+   }
+}
+
+//searchFrom() as it was when contradictions were thrown: propagate()
+//throws, and each guess catches whatever its own propagation threw.
+//Only that one throw is left; the rule that finds the contradiction
+//returns it like any other, rather than throwing from deep inside.
+SearchResult searchByThrowing(RowManager &m)
+{
+   try
+   {
+      if(propagate(m))
+         return SEARCH_SOLVED;
+   }
+   catch(const char*)
+   {
+      return SEARCH_CONTRADICTION;
+   }
+   int row, column;
+   if(!chooseCell(m, row, column))
+      return fullBoardIsValid(m) ? SEARCH_SOLVED : SEARCH_CONTRADICTION;
+   for(int guess = 0; guess < 2; guess++)
+   {
+      m.trail->mark(m.numUnsolved);
+      m.guessCount++;
+      SearchResult result = SEARCH_CONTRADICTION;
+      try
+      {
+         if(!(guess == 0 ? m.stripes[row]->fill(column) : m.stripes[row]->empty(column)))
+            throw "Logic error!";
+         m.dirty.push(row);
+         collectChanges(m, row);
+         result = searchByThrowing(m);
+      }
+      catch(const char*)
+      {
+         result = SEARCH_CONTRADICTION;
+      }
+      if(result == SEARCH_SOLVED)
+         return SEARCH_SOLVED;
+      m.numUnsolved = m.trail->undo(m.g);
+      clearPendingWork(m);
+   }
+   return SEARCH_CONTRADICTION;
+}
+
+//search(), on top of searchByThrowing.
+bool searchThrowing(RowManager &m)
+{
+   try
+   {
+      if(propagate(m))
+         return true;
+   }
+   catch(const char*)
+   {
+      return false;
+   }
+   Trail trail;
+   m.trail = &trail;
+   m.g->trail = trail.cellLog();
+   SearchResult result = searchByThrowing(m);
+   m.g->trail = NULL;
+   m.trail = NULL;
+   return result == SEARCH_SOLVED;
+}
+
+//Solves each generated puzzle with both searches, which should make the
+//same guesses in the same order and end up with the same picture.
+void benchmarkGuesses(CheckMode mode, int repeat)
+{
+   const int sizes[] = { 15, 20, 22 };
+   const int count = 10;
+   cout << "size\tpuzzles\tmode\tguesses\tstatus ms\tone throw ms\tspeedup\tsame" << endl;
+   for(int c = 0; c < 3; c++)
+   {
+      long guesses[2] = { 0, 0 };
+      double seconds[2] = { 0, 0 };
+      bool same = true;
+      for(int i = 0; i < count; i++)
+      {
+         PuzzleClues clues = generatePuzzle(sizes[c], sizes[c], 0.5, sizes[c] * 1000 + i);
+         string pictures[2];
+         for(int way = 0; way < 2; way++)
+         {
+            for(int rep = 0; rep < repeat; rep++)
+            {
+               RowManager allRows;
+               buildPuzzle(clues, allRows);
+               allRows.mode = mode;
+               chrono::steady_clock::time_point start = chrono::steady_clock::now();
+               initSchedule(allRows);
+               bool solved = way == 0 ? search(allRows) : searchThrowing(allRows);
+               seconds[way] += chrono::duration<double>(chrono::steady_clock::now() - start).count();
+               if(rep == 0)
+               {
+                  guesses[way] += allRows.guessCount;
+                  pictures[way] = solved ? "" : "no solution";
+                  for(int r = 0; solved && r < allRows.numOfRows; r++)
+                     for(int col = 0; col < allRows.numOfCols; col++)
+                        pictures[way] += allRows.g->cell(r, col);
+               }
+               freePuzzle(allRows);
+            }
+         }
+         same = same && pictures[0] == pictures[1];
+      }
+      same = same && guesses[0] == guesses[1];
+      cout << sizes[c] << "x" << sizes[c] << "\t" << count << "\t" << modeNames[mode] << "\t" << guesses[0] << "\t"
+           << seconds[0] * 1e3 / repeat << "\t" << seconds[1] * 1e3 / repeat << "\t" << seconds[1] / seconds[0]
+           << "\t" << (same ? "yes" : "NO") << endl;
+   }
+}
+
+//Solves every puzzle of benchmarkGuesses once with searchBoard() and then
+//with the parallel search on ever more threads. With more than one
+//thread, the search can find a different solution and make a different
+//number of guesses; it should still find one for every puzzle.
+void benchmarkParallelSearch(CheckMode mode, int maxThreads, int repeat)
+{
+   const int sizes[] = { 15, 20, 22 };
+   const int count = 10;
+   vector<PuzzleClues> puzzles;
+   for(int c = 0; c < 3; c++)
+      for(int i = 0; i < count; i++)
+         puzzles.push_back(generatePuzzle(sizes[c], sizes[c], 0.5, sizes[c] * 1000 + i));
+   if(maxThreads <= 0)
+      maxThreads = ThreadPool().size();
+   vector<int> counts(1, 0); //0 for searchBoard()
+   for(int threads = 1; threads < maxThreads; threads *= 2)
+      counts.push_back(threads);
+   counts.push_back(maxThreads);
+   cout << "threads\tpuzzles\tmode\tsolved\tguesses\tms\tspeedup\tguesses/s\tsteals\tidle %" << endl;
+   double serialSeconds = 0;
+   for(size_t t = 0; t < counts.size(); t++)
+   {
+      int threads = counts[t];
+      ThreadPool *pool = threads > 0 ? new ThreadPool(threads) : NULL;
+      long guesses = 0, steals = 0;
+      int solved = 0;
+      double seconds = 0, searchSeconds = 0, idleSeconds = 0;
+      for(size_t p = 0; p < puzzles.size(); p++)
+         for(int rep = 0; rep < repeat; rep++)
+         {
+            RowManager allRows;
+            buildPuzzle(puzzles[p], allRows);
+            allRows.mode = mode;
+            allRows.pool = pool;
+            chrono::steady_clock::time_point start = chrono::steady_clock::now();
+            initSchedule(allRows);
+            SearchResult result = (pool != NULL) ? searchBoardParallel(allRows) : searchBoard(allRows);
+            double took = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+            seconds += took;
+            searchSeconds += (pool != NULL) ? allRows.searchTime : took;
+            idleSeconds += allRows.idleTime;
+            if(rep == 0)
+            {
+               guesses += allRows.guessCount;
+               steals += allRows.steals;
+               solved += result == SEARCH_SOLVED;
+            }
+            freePuzzle(allRows);
+         }
+      delete pool;
+      if(threads == 0)
+         serialSeconds = seconds;
+      cout << (threads == 0 ? string("serial") : to_string(threads)) << "\t" << puzzles.size() << "\t" << modeNames[mode]
+           << "\t" << solved << "\t" << guesses << "\t" << seconds * 1e3 / repeat << "\t" << serialSeconds / seconds
+           << "\t" << (long)(guesses * repeat / seconds) << "\t" << steals << "\t"
+           << 100 * idleSeconds / max(searchSeconds * max(threads, 1), 1e-9) << endl;
+   }
+}
+
+//Counts the solutions of generated puzzles up to two, the way a
+//pipeline that only publishes puzzles with one solution would.
+void benchmarkUniqueness(CheckMode mode, int repeat)
+{
+   const int sizes[] = { 10, 15, 20, 25 };
+   const int count = 100;
+   cout << "size\tpuzzles\tmode\tprobing\tunique\tmultiple\twitness cells\tguesses\tpuzzles/s" << endl;
+   for(int c = 0; c < 4; c++)
+      for(int probing = 0; probing < 2; probing++)
+      {
+         int unique = 0, multiple = 0;
+         long witnessCells = 0, guesses = 0;
+         double seconds = 0;
+         for(int i = 0; i < count; i++)
+         {
+            PuzzleClues clues = generatePuzzle(sizes[c], sizes[c], 0.6, sizes[c] * 1000 + i);
+            for(int rep = 0; rep < repeat; rep++)
+            {
+               RowManager allRows;
+               buildPuzzle(clues, allRows);
+               allRows.mode = mode;
+               allRows.probing = probing == 1;
+               SolutionCount solutions(2);
+               chrono::steady_clock::time_point start = chrono::steady_clock::now();
+               initSchedule(allRows);
+               countSolutions(allRows, solutions);
+               seconds += chrono::duration<double>(chrono::steady_clock::now() - start).count();
+               if(rep == 0)
+               {
+                  unique += solutions.found == 1;
+                  multiple += solutions.found > 1;
+                  witnessCells += solutions.witness.size();
+                  guesses += allRows.guessCount;
+               }
+               freePuzzle(allRows);
+            }
+         }
+         cout << sizes[c] << "x" << sizes[c] << "\t" << count << "\t" << modeNames[mode] << "\t"
+              << (probing ? "yes" : "no") << "\t" << unique << "\t" << multiple << "\t"
+              << (multiple > 0 ? (double)witnessCells / multiple : 0) << "\t" << guesses << "\t"
+              << count * repeat / seconds << endl;
+      }
+}
+
+//Solves each puzzle, searching if need be, with the stripes taken off
+//the queue in turn and then by priority, and adds up both over all of them.
+void benchmarkOrder(const vector<string> &files, CheckMode mode, int repeat)
+{
+   const char *orderNames[] = { "in turn", "priority" };
+   long totalChecks[2] = { 0, 0 }, totalSaved[2] = { 0, 0 }, totalGuesses[2] = { 0, 0 };
+   double totalSeconds[2] = { 0, 0 };
+   cout << "puzzle\tmode\torder\tresult\tchecks\tround-robin checks\tguesses\tms/solve" << endl;
+   for(size_t f = 0; f < files.size(); f++)
+      for(int order = 0; order < 2; order++)
+      {
+         string result;
+         int checks = 0, saved = 0, guesses = 0;
+         double seconds = 0;
+         for(int rep = 0; rep < repeat; rep++)
+         {
+            ifstream infile(files[f].c_str());
+            if(!infile)
+            {
+               result = "missing";
+               break;
+            }
+            RowManager allRows;
+            if(!loadPuzzle(infile, allRows))
+            {
+               result = "unbalanced";
+               freePuzzle(allRows);
+               break;
+            }
+            allRows.mode = mode;
+            allRows.dirty.byPriority = order == 1;
+            chrono::steady_clock::time_point start = chrono::steady_clock::now();
+            initSchedule(allRows);
+            SearchResult searched = searchBoard(allRows);
+            seconds += chrono::duration<double>(chrono::steady_clock::now() - start).count();
+            result = searched == SEARCH_SOLVED ? "solved" : "no-solution";
+            checks = allRows.checkCount;
+            saved = allRows.checksSaved;
+            guesses = allRows.guessCount;
+            freePuzzle(allRows);
+         }
+         cout << files[f] << "\t" << modeNames[mode] << "\t" << orderNames[order] << "\t" << result << "\t";
+         if(seconds == 0)
+         {
+            cout << "-\t-\t-\t-" << endl;
+            continue;
+         }
+         cout << checks << "\t" << checks + saved << "\t" << guesses << "\t" << seconds * 1e3 / repeat << endl;
+         totalChecks[order] += checks;
+         totalSaved[order] += saved;
+         totalGuesses[order] += guesses;
+         totalSeconds[order] += seconds / repeat;
+      }
+   for(int order = 0; order < 2; order++)
+      cout << "total\t" << modeNames[mode] << "\t" << orderNames[order] << "\t-\t" << totalChecks[order] << "\t"
+           << totalChecks[order] + totalSaved[order] << "\t" << totalGuesses[order] << "\t" << totalSeconds[order] * 1e3 << endl;
+}
+
+//Writes "count" copies of each of a few solved puzzles into one stream
+//per format, and once more a character at a time through <<, which is
+//how printToFile used to do it. The output goes nowhere.
+void benchmarkFormats(int repeat)
+{
+   const int sizes[] = { 25, 200, 1000 };
+   const int counts[] = { 2000, 100, 10 };
+   cout << "size\tpictures\tformat\tbytes/picture\tus/picture" << endl;
+   for(int c = 0; c < 3; c++)
+   {
+      RowManager allRows;
+      buildPuzzle(generatePuzzle(sizes[c], sizes[c], 0.9, sizes[c]), allRows);
+      initSchedule(allRows);
+      propagateStripes(allRows);
+      GameGrid &g = *allRows.g;
+      int count = counts[c] * repeat;
+      for(int f = -1; f < 4; f++)
+      {
+         ofstream out("/dev/null", ios::binary);
+         size_t bytes = 0;
+         chrono::steady_clock::time_point start = chrono::steady_clock::now();
+         if(f < 0)
+         {
+            for(int n = 0; n < count; n++)
+               for(int i = 0; i < g.getRows(); i++)
+               {
+                  for(int j = 0; j < g.getColumns(); j++)
+                     out << g.cell(i, j);
+                  out << endl;
+               }
+            bytes = (size_t)g.getRows() * (g.getColumns() + 1) * count;
+         }
+         else
+         {
+            PictureWriter writer(out, (PictureFormat)f, true);
+            for(int n = 0; n < count; n++)
+               writer.write(g, "puzzle" + to_string(n));
+            writer.flush();
+            bytes = writer.bytesWritten();
+         }
+         double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+         cout << sizes[c] << "x" << sizes[c] << "\t" << count << "\t" << (f < 0 ? "text <<" : pictureFormatNames[f])
+              << "\t" << bytes / count << "\t" << seconds * 1e6 / count << endl;
+      }
+      freePuzzle(allRows);
+   }
+}
+
+int main(int argc, char *argv[])
+{
+   int repeat = 5;
+   bool lines = false, mirror = true, suite = false, guesses = false, formats = false, masks = false, parallel = false, unique = false, order = false;
+   CheckMode mode = RULES_ONLY;
+   double density = 0.8;
+   int maxSize = 2000, cacheMB = 0, threads = 0;
+   string resultsName;
+   vector<string> files;
+   for(int i = 1; i < argc; i++)
+   {
+      if(string(argv[i]) == "-repeat" && i + 1 < argc)
+         repeat = atoi(argv[++i]);
+      else if(string(argv[i]) == "-generate" && i + 4 < argc)
+      {
+         writePuzzle(cout, generatePuzzle(atoi(argv[i+1]), atoi(argv[i+2]), atof(argv[i+3]), atoi(argv[i+4])));
+         return 0;
+      }
+      else if(string(argv[i]) == "-suite")
+         suite = true;
+      else if(string(argv[i]) == "-mode" && i + 1 < argc)
+      {
+         string name = argv[++i];
+         if(name == "final")
+            mode = RULES_THEN_LINE_SOLVER;
+         else if(name == "exact")
+            mode = LINE_SOLVER_ONLY;
+         else if(name != "rules")
+            cerr << "Unknown mode " << name << "; use rules, final or exact." << endl;
+      }
+      else if(string(argv[i]) == "-density" && i + 1 < argc)
+         density = atof(argv[++i]);
+      else if(string(argv[i]) == "-maxsize" && i + 1 < argc)
+         maxSize = atoi(argv[++i]);
+      else if(string(argv[i]) == "-results" && i + 1 < argc)
+         resultsName = argv[++i];
+      else if(string(argv[i]) == "-lines")
+         lines = true;
+      else if(string(argv[i]) == "-guesses")
+         guesses = true;
+      else if(string(argv[i]) == "-search")
+         parallel = true;
+      else if(string(argv[i]) == "-unique")
+         unique = true;
+      else if(string(argv[i]) == "-threads" && i + 1 < argc)
+         threads = atoi(argv[++i]);
+      else if(string(argv[i]) == "-order")
+         order = true;
+      else if(string(argv[i]) == "-formats")
+         formats = true;
+      else if(string(argv[i]) == "-masks")
+         masks = true;
+      else if(string(argv[i]) == "-nomirror")
+         mirror = false;
+      else if(string(argv[i]) == "-cache" && i + 1 < argc)
+         cacheMB = atoi(argv[++i]);
+      else
+         files.push_back(argv[i]);
+   }
+   if(lines)
+   {
+      benchmarkLines(repeat);
+      return 0;
+   }
+   if(masks)
+   {
+      benchmarkMasks(repeat);
+      return 0;
+   }
+   if(formats)
+   {
+      benchmarkFormats(repeat);
+      return 0;
+   }
+   if(guesses)
+   {
+      benchmarkGuesses(mode, repeat);
+      return 0;
+   }
+   if(parallel)
+   {
+      benchmarkParallelSearch(mode, threads, repeat);
+      return 0;
+   }
+   if(unique)
+   {
+      benchmarkUniqueness(mode, repeat);
+      return 0;
+   }
+   if(order && !files.empty())
+   {
+      benchmarkOrder(files, mode, repeat);
+      return 0;
+   }
+   if(suite)
+   {
+      ofstream resultsFile;
+      if(!resultsName.empty())
+         resultsFile.open(resultsName.c_str());
+      runSuite(mode, density, maxSize, mirror, resultsName.empty() ? cout : resultsFile);
+#ifdef NONOGRAM_RULE_STATS
+      dumpRuleStats(cerr);
+#endif
+      return 0;
+   }
+   if(files.empty())
+   {
+      cout << "Usage: NonogramBenchmark [-repeat n] [-nomirror] [-cache n] puzzle1.txt puzzle2.txt ..." << endl;
+      cout << "       NonogramBenchmark [-repeat n] -lines" << endl;
+      cout << "       NonogramBenchmark -suite [-mode rules|final|exact] [-density d]" << endl;
+      cout << "          [-maxsize n] [-nomirror] [-results file]" << endl;
+      cout << "       NonogramBenchmark -guesses [-repeat n] [-mode rules|final|exact]" << endl;
+      cout << "       NonogramBenchmark -search [-threads n] [-repeat n] [-mode rules|final|exact]" << endl;
+      cout << "       NonogramBenchmark -unique [-repeat n] [-mode rules|final|exact]" << endl;
+      cout << "       NonogramBenchmark -order [-repeat n] [-mode rules|final|exact] puzzle1.txt puzzle2.txt ..." << endl;
+      cout << "       NonogramBenchmark -formats [-repeat n]" << endl;
+      cout << "       NonogramBenchmark -masks [-repeat n]" << endl;
+      cout << "       NonogramBenchmark -generate rows columns density seed" << endl;
+      return 1;
+   }
+
+   cout << "puzzle\tsize\tmode\tresult\tchecks\tms/solve\tus/check\tgrid KB\tcache hit %" << endl;
+   for(size_t f = 0; f < files.size(); f++)
+   {
+      for(int mode = RULES_ONLY; mode <= LINE_SOLVER_ONLY; mode++)
+      {
+         string result;
+         int checks = 0, rows = 0, cols = 0;
+         size_t gridBytes = 0;
+         double hitRate = 0;
+         double totalSeconds = 0;
+         for(int rep = 0; rep < repeat; rep++)
+         {
+            ifstream infile(files[f].c_str());
+            if(!infile)
+            {
+               result = "missing";
+               break;
+            }
+            RowManager allRows;
+            bool balanced = loadPuzzle(infile, allRows, mirror);
+            gridBytes = allRows.g->memoryUsed();
+            rows = allRows.numOfRows;
+            cols = allRows.numOfCols;
+            allRows.mode = (CheckMode)mode;
+            LineCache *cache = NULL;
+            if(cacheMB > 0)
+               cache = new LineCache((size_t)cacheMB << 20);
+            allRows.cache = cache;
+            chrono::steady_clock::time_point start = chrono::steady_clock::now();
+            if(!balanced)
+               result = "unbalanced";
+            else
+            {
+               initSchedule(allRows);
+               PropagateResult propagated = propagateStripes(allRows);
+               result = propagated == PROPAGATE_SOLVED ? "solved"
+                        : propagated == PROPAGATE_STALLED ? "stalled" : "contradiction";
+            }
+            totalSeconds += chrono::duration<double>(chrono::steady_clock::now() - start).count();
+            checks = allRows.checkCount;
+            freePuzzle(allRows);
+            if(cache != NULL)
+            {
+               if(cache->hits + cache->misses > 0)
+                  hitRate = 100.0 * cache->hits / (cache->hits + cache->misses);
+               delete cache;
+            }
+         }
+         if(result == "missing")
+         {
+            cout << files[f] << "\t-\t-\tmissing" << endl;
+            break;
+         }
+         double perSolve = totalSeconds / repeat;
+         cout << files[f] << "\t" << rows << "x" << cols << "\t" << modeNames[mode] << "\t" << result
+              << "\t" << checks << "\t" << perSolve * 1e3 << "\t"
+              << (checks > 0 ? perSolve * 1e6 / checks : 0) << "\t" << gridBytes / 1024.0 << "\t";
+         if(cacheMB > 0)
+            cout << hitRate << endl;
+         else
+            cout << "-" << endl;
+      }
+   }
+#ifdef NONOGRAM_RULE_STATS
+   dumpRuleStats(cerr);
+#endif
+}
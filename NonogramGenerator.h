@@ -0,0 +1,83 @@
+//Title: NonogramGenerator.h
+//Description: Makes up puzzles for testing and benchmarking:
+//a random picture, with each cell dark at a given density, and
+//the clues that go with it. The same size, density and seed
+//always give the same puzzle, on any machine.
+
+#ifndef NONOGRAMGENERATOR_H
+#define NONOGRAMGENERATOR_H
+
+#include "NonogramLoader.h"
+#include <iostream>
+#include <vector>
+#include <random>
+#include <stdint.h>
+
+using namespace std;
+
+//Adds the clues for one stripe of the picture to the puzzle.
+inline void addClues(PuzzleClues &clues, const vector<char> &line)
+{
+   int run = 0, count = 0;
+   for(size_t i = 0; i <= line.size(); i++)
+   {
+      if(i < line.size() && line[i])
+         run++;
+      else if(run > 0)
+      {
+         clues.lengths.push_back(run);
+         count++;
+         run = 0;
+      }
+   }
+   clues.counts.push_back(count);
+}
+
+//The clues of a random rows x columns picture. mt19937 gives the same
+//numbers everywhere, and its raw output is used directly (rather than
+//through a distribution, which is up to the library) to keep it that way.
+inline PuzzleClues generatePuzzle(int rows, int columns, double density, uint32_t seed)
+{
+   mt19937 random(seed);
+   uint32_t threshold = (uint32_t)(density * 4294967295.0);
+   vector<char> picture(rows * columns);
+   for(size_t i = 0; i < picture.size(); i++)
+      picture[i] = random() < threshold;
+
+   PuzzleClues clues;
+   clues.rows = rows;
+   clues.cols = columns;
+   clues.line = 1;
+   vector<char> line(columns);
+   for(int i = 0; i < rows; i++)
+   {
+      for(int j = 0; j < columns; j++)
+         line[j] = picture[i * columns + j];
+      addClues(clues, line);
+   }
+   line.resize(rows);
+   for(int j = 0; j < columns; j++)
+   {
+      for(int i = 0; i < rows; i++)
+         line[i] = picture[i * columns + j];
+      addClues(clues, line);
+   }
+   return clues;
+}
+
+//Writes a puzzle out in the clue file format (see NonogramLoader.h).
+inline void writePuzzle(ostream &out, const PuzzleClues &clues)
+{
+   out << clues.rows << " " << clues.cols << "\n";
+   int k = 0;
+   for(int i = 0; i < clues.rows + clues.cols; i++)
+   {
+      if(i == clues.rows)
+         out << "\n";
+      for(int n = 0; n < clues.counts[i]; n++)
+         out << (n > 0 ? " " : "") << clues.lengths[k++];
+      out << "\n";
+   }
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,264 @@
+//Title: NonogramLineCache.h
+//Description: Remembers what checking a stripe did, so that a
+//stripe that comes up again in exactly the same state is settled
+//without running the rules. The same line turns up over and over
+//in symmetric pictures, in puzzles with many identical clues, and
+//above all while guessing, where the same stripes get checked again
+//after every guess that is taken back.
+//A stripe's state is its clues, its cells, and (for the rules, which
+//narrow them down as they go) where each segment can still be. What
+//a check did is the cells it decided, in the order it decided them,
+//and where that left the segments; or else that it found a
+//contradiction. Playing that back leaves the stripe, the grid and
+//the scheduler's queue just as the check itself would have.
+
+#ifndef NONOGRAMLINECACHE_H
+#define NONOGRAMLINECACHE_H
+
+#include "NonogramLogic.h"
+#include "NonogramObjects.h"
+#include <iostream>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <algorithm>
+#include <stdint.h>
+
+using namespace std;
+
+//A table of checks, shared by every puzzle and thread that is handed it.
+//It is split into shards with a lock and a share of the memory each, so
+//that threads rarely wait on each other; a shard that runs out of memory
+//is emptied and starts over.
+class LineCache
+{
+   private:
+   struct Entry
+   {
+      uint64_t hash;
+      size_t keyWords;
+      vector<uint64_t> words; //the key, then what the check did
+   };
+
+   struct Shard
+   {
+      mutex lock;
+      vector<Entry> slots;
+      size_t bytes;
+   };
+
+   static const int numShards = 64;
+   Shard shards[numShards];
+   size_t shardLimit;
+
+   public:
+   atomic<uint64_t> hits, misses, stores, flushes;
+
+   //Uses at most about "limit" bytes for the table and its entries.
+   LineCache(size_t limit)
+   {
+      shardLimit = limit / numShards;
+      //room for an entry of a couple of hundred bytes in every slot
+      size_t slotsPerShard = max(shardLimit / 256, (size_t)4);
+      for(int s = 0; s < numShards; s++)
+      {
+         shards[s].slots.resize(slotsPerShard);
+         shards[s].bytes = slotsPerShard * sizeof(Entry);
+         for(size_t i = 0; i < slotsPerShard; i++)
+            shards[s].slots[i].keyWords = 0;
+      }
+      hits = misses = stores = flushes = 0;
+   }
+
+   //Copies what was stored under this key into "result". Returns false if nothing was.
+   bool find(uint64_t hash, const vector<uint64_t> &key, vector<uint64_t> &result)
+   {
+      Shard &shard = shards[hash % numShards];
+      lock_guard<mutex> guard(shard.lock);
+      Entry &e = shard.slots[(hash / numShards) % shard.slots.size()];
+      if(e.keyWords != key.size() || e.hash != hash || !equal(key.begin(), key.end(), e.words.begin()))
+      {
+         misses++;
+         return false;
+      }
+      hits++;
+      result.assign(e.words.begin() + e.keyWords, e.words.end());
+      return true;
+   }
+
+   //Stores what a check did under its key, in place of whatever had the same slot.
+   void store(uint64_t hash, const vector<uint64_t> &key, const vector<uint64_t> &result)
+   {
+      size_t size = (key.size() + result.size()) * sizeof(uint64_t);
+      if(size + shards[0].slots.size() * sizeof(Entry) > shardLimit)
+         return; //a line this long would empty its shard every time
+      Shard &shard = shards[hash % numShards];
+      lock_guard<mutex> guard(shard.lock);
+      Entry &e = shard.slots[(hash / numShards) % shard.slots.size()];
+      shard.bytes -= e.words.capacity() * sizeof(uint64_t);
+      if(shard.bytes + size > shardLimit)
+      {
+         for(size_t i = 0; i < shard.slots.size(); i++)
+         {
+            shard.slots[i].keyWords = 0;
+            vector<uint64_t>().swap(shard.slots[i].words);
+         }
+         shard.bytes = shard.slots.size() * sizeof(Entry);
+         flushes++;
+      }
+      e.hash = hash;
+      e.keyWords = key.size();
+      e.words.assign(key.begin(), key.end());
+      e.words.insert(e.words.end(), result.begin(), result.end());
+      shard.bytes += e.words.capacity() * sizeof(uint64_t);
+      stores++;
+   }
+
+   //bytes in use right now, for the statistics
+   size_t memoryUsed()
+   {
+      size_t total = 0;
+      for(int s = 0; s < numShards; s++)
+      {
+         lock_guard<mutex> guard(shards[s].lock);
+         total += shards[s].bytes;
+      }
+      return total;
+   }
+
+   void printStats(ostream &out)
+   {
+      uint64_t lookups = hits + misses;
+      out << "Line cache: " << hits << " hits, " << misses << " misses ("
+          << (lookups > 0 ? 100.0 * hits / lookups : 0) << "% hit rate), " << stores << " stored, "
+          << flushes << " flushes, " << memoryUsed() / 1024 << " KB in use" << endl;
+   }
+};
+
+inline uint64_t mixKey(uint64_t hash, uint64_t word)
+{
+   hash = (hash ^ word) * 0x9E3779B97F4A7C15ULL;
+   return hash ^ (hash >> 29);
+}
+
+//Builds the key for the stripe as it is now and returns its hash.
+//The exact line solver works out the segments' bounds from scratch,
+//so in that mode the bounds they came in with are left out.
+template<class Line>
+uint64_t lineKey(Line *row, CheckMode mode, vector<uint64_t> &key)
+{
+   int n = row->getLength(), k = row->getNumSegments();
+   key.clear();
+   key.push_back((uint64_t)mode | (uint64_t)n << 2 | (uint64_t)k << 32);
+   for(int j = 0; j < k; j += 2)
+      key.push_back((uint32_t)row->getSegment(j)->length
+                    | (j + 1 < k ? (uint64_t)row->getSegment(j + 1)->length << 32 : 0));
+   for(int j = 0; j < k; j += 64)
+   {
+      uint64_t placed = 0;
+      for(int b = 0; b < 64 && j + b < k; b++)
+         if(row->getSegment(j + b)->placed)
+            placed |= (uint64_t)1 << b;
+      key.push_back(placed);
+   }
+   if(mode != LINE_SOLVER_ONLY)
+      for(int j = 0; j < k; j++)
+         key.push_back((uint32_t)row->getSegment(j)->minpos | (uint64_t)(uint32_t)row->getSegment(j)->maxpos << 32);
+   for(int i = 0; i < n; i += 64)
+   {
+      uint64_t dark, light;
+      readCells(row, i, dark, light);
+      key.push_back(dark);
+      key.push_back(light);
+   }
+   uint64_t hash = 0;
+   for(size_t w = 0; w < key.size(); w++)
+      hash = mixKey(hash, key[w]);
+   return hash;
+}
+
+//What a check did, for the cache: first word 0 for a contradiction,
+//or 1 plus twice the number of cells decided; then the cells, each
+//one's position shifted up by one with the low bit set if it was
+//emptied; then every segment's bounds and whether it was placed.
+template<class Line>
+void recordCheck(Line *row, bool ok, size_t changesBefore, NonogramStripe *stripe, vector<uint64_t> &result)
+{
+   result.clear();
+   if(!ok)
+   {
+      result.push_back(0);
+      return;
+   }
+   size_t decided = stripe->changes.size() - changesBefore;
+   result.push_back(1 + 2 * decided);
+   for(size_t c = changesBefore; c < stripe->changes.size(); c++)
+   {
+      int position = stripe->changes[c];
+      result.push_back((uint64_t)position << 1 | (row->cellAt(position) == ' ' ? 1 : 0));
+   }
+   int k = row->getNumSegments();
+   for(int j = 0; j < k; j++)
+   {
+      Segment *s = row->getSegment(j);
+      result.push_back((uint32_t)s->minpos | (uint64_t)(uint32_t)s->maxpos << 32 | (uint64_t)s->placed << 31);
+   }
+}
+
+//Does to the stripe what recordCheck saw a check do.
+template<class Line>
+bool replayCheck(Line *row, const vector<uint64_t> &result)
+{
+   if(result[0] == 0)
+      return false;
+   size_t decided = result[0] >> 1;
+   for(size_t c = 1; c <= decided; c++)
+   {
+      int position = (int)(result[c] >> 1);
+      if(!((result[c] & 1) ? row->empty(position) : row->fill(position)))
+         return false; //can't happen, since the cells were part of the key
+   }
+   int k = row->getNumSegments();
+   for(int j = 0; j < k; j++)
+   {
+      uint64_t word = result[decided + 1 + j];
+      Segment *s = row->getSegment(j);
+      s->minpos = (int)(word & 0x7FFFFFFF);
+      s->maxpos = (int)(uint32_t)(word >> 32);
+      s->placed = (word >> 31) & 1;
+   }
+   return true;
+}
+
+template<class Line>
+bool checkLineCached(LineCache &cache, Line *row, NonogramStripe *stripe, CheckMode mode)
+{
+   static thread_local vector<uint64_t> key, result;
+   uint64_t hash = lineKey(row, mode, key);
+   if(cache.find(hash, key, result))
+      return replayCheck(row, result);
+   size_t changesBefore = stripe->changes.size();
+   bool ok = checkLine(row, mode);
+   recordCheck(row, ok, changesBefore, stripe, result);
+   cache.store(hash, key, result);
+   return ok;
+}
+
+//checkStripe, through the cache.
+inline bool checkStripeCached(LineCache &cache, NonogramStripe* row, CheckMode mode = RULES_ONLY)
+{
+   if (NonogramRow *r = dynamic_cast<NonogramRow*>(row))
+   {
+      StripeView<NonogramRow> view(r);
+      return checkLineCached(cache, &view, row, mode);
+   }
+   else if (NonogramColumn *c = dynamic_cast<NonogramColumn*>(row))
+   {
+      StripeView<NonogramColumn> view(c);
+      return checkLineCached(cache, &view, row, mode);
+   }
+   else
+      return checkLineCached(cache, row, row, mode);
+}
+
+#endif
\ No newline at end of file
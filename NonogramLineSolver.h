@@ -0,0 +1,155 @@
+//Title: NonogramLineSolver.h
+//Description: An exact line solver. Unlike the rules in
+//NonogramLogic.h, which each make one kind of partial
+//deduction, this finds every cell that is forced by a
+//stripe's clues and its current cells, using a dynamic
+//program over segment placements that takes O(n*k) time
+//for a stripe of length n with k segments.
+
+#ifndef NONOGRAMLINESOLVER_H
+#define NONOGRAMLINESOLVER_H
+
+#include "NonogramObjects.h"
+#include <vector>
+
+using namespace std;
+
+//Returns false if there is no way to place the segments at all.
+template<class Line>
+bool solveLine(Line* row)
+{
+   int n = row->getLength();
+   int k = row->getNumSegments();
+   vector<int> lengths(k);
+   for(int j = 0; j < k; j++)
+      lengths[j] = row->getSegment(j)->length;
+
+   vector<char> cells(n);
+   vector<int> emptyBefore(n + 1, 0); //number of empty cells in [0,i)
+   for(int i = 0; i < n; i++)
+   {
+      cells[i] = row->cellAt(i);
+      emptyBefore[i + 1] = emptyBefore[i] + (cells[i] == ' ');
+   }
+
+   //fits[j][i]: the first j segments fit in cells [0,i),
+   //with every filled cell in there covered by one of them.
+   //rest[j][i]: segments j to k-1 fit in cells [i,n) the same way.
+   //Both tables are stored flat, as fits[j*width + i].
+   int width = n + 2;
+   vector<char> fits((k + 1) * width, 0);
+   vector<char> rest((k + 1) * width, 0);
+   fits[0] = 1;
+   for(int i = 1; i <= n; i++)
+      fits[i] = fits[i-1] && cells[i-1] != '#';
+   rest[k*width + n] = 1;
+   for(int i = n - 1; i >= 0; i--)
+      rest[k*width + i] = rest[k*width + i+1] && cells[i] != '#';
+   for(int j = 1; j <= k; j++)
+   {
+      int len = lengths[j-1];
+      for(int i = 1; i <= n; i++)
+      {
+         bool result = cells[i-1] != '#' && fits[j*width + i-1];
+         int start = i - len;
+         if(!result && start >= 0 && emptyBefore[i] == emptyBefore[start])
+         {
+            if(start == 0)
+               result = (j == 1);
+            else
+               result = cells[start-1] != '#' && fits[(j-1)*width + start-1];
+         }
+         fits[j*width + i] = result;
+      }
+   }
+   for(int j = k - 1; j >= 0; j--)
+   {
+      int len = lengths[j];
+      for(int i = n - 1; i >= 0; i--)
+      {
+         bool result = cells[i] != '#' && rest[j*width + i+1];
+         int end = i + len;
+         if(!result && end <= n && emptyBefore[end] == emptyBefore[i])
+         {
+            if(end == n)
+               result = (j == k - 1);
+            else
+               result = cells[end] != '#' && rest[(j+1)*width + end+1];
+         }
+         rest[j*width + i] = result;
+      }
+   }
+   if(!fits[k*width + n])
+      return false;
+
+   //Every start a segment can take in some complete placement;
+   //the cells it covers from there could be filled.
+   vector<int> coverage(n + 1, 0);
+   vector<int> lowest(k), highest(k);
+   for(int j = 0; j < k; j++)
+   {
+      Segment *s = row->getSegment(j);
+      int len = lengths[j];
+      int low = -1, high = -1;
+      for(int start = 0; start + len <= n; start++)
+      {
+         int end = start + len;
+         if(emptyBefore[end] != emptyBefore[start])
+            continue;
+         bool leftOK = (start == 0) ? (j == 0) : (cells[start-1] != '#' && fits[j*width + start-1]);
+         bool rightOK = (end == n) ? (j == k - 1) : (cells[end] != '#' && rest[(j+1)*width + end+1]);
+         if(leftOK && rightOK)
+         {
+            if(low < 0)
+               low = start;
+            high = start;
+            coverage[start]++;
+            coverage[end]--;
+         }
+      }
+      s->minpos = lowest[j] = low;
+      s->maxpos = highest[j] = high;
+      if(low == high)
+         s->placed = true;
+   }
+
+   //A cell can be empty if it lies in the gap after segment j-1
+   //(or before the first segment) in some complete placement.
+   //Only the gaps between the segments that can still reach
+   //past the cell and those that can already be over need a look.
+   vector<char> result(cells);
+   int covered = 0;
+   int firstGap = 0, lastGap = 0;
+   for(int i = 0; i < n; i++)
+   {
+      covered += coverage[i];
+      while(firstGap < k && highest[firstGap] <= i)
+         firstGap++;
+      while(lastGap < k && lowest[lastGap] + lengths[lastGap] <= i)
+         lastGap++;
+      bool canFill = covered > 0;
+      bool canEmpty = false;
+      for(int j = firstGap; j <= lastGap && !canEmpty && cells[i] != '#'; j++)
+         canEmpty = fits[j*width + i] && rest[j*width + i+1];
+      if(!canFill)
+         result[i] = ' ';
+      else if(!canEmpty)
+         result[i] = '#';
+   }
+
+   //write the new cells back a run at a time
+   int i = 0;
+   while(i < n)
+   {
+      int start = i;
+      while(i < n && result[i] == result[start])
+         i++;
+      if(result[start] == '#' && !row->fill(start, i))
+         return false;
+      else if(result[start] == ' ' && !row->empty(start, i))
+         return false;
+   }
+   return true;
+};
+
+#endif
@@ -0,0 +1,25 @@
+//Title: NonogramLinkCheck.cpp
+//Description: Includes every header a second time, in a translation
+//unit of its own, so that building NonogramSolver.cpp together with
+//this file (see the README) fails if any of them defines something
+//that isn't inline. A program using the solver as a library can
+//include NonogramSolver.h from as many of its files as it likes.
+//Built with -DNONOGRAM_RULE_STATS, it checks the counters as well.
+
+#include "NonogramSolver.h"
+#include "NonogramServer.h"
+#include "NonogramObjects.h"
+#include "NonogramLogic.h"
+#include "NonogramLineSolver.h"
+#include "NonogramMaskSolver.h"
+#include "NonogramLineCache.h"
+#include "NonogramScheduler.h"
+#include "NonogramLoader.h"
+#include "NonogramSearch.h"
+#include "NonogramProbe.h"
+#include "NonogramParallelSearch.h"
+#include "NonogramThreads.h"
+#include "NonogramLog.h"
+#include "NonogramOutput.h"
+#include "NonogramGenerator.h"
+#include "NonogramRuleStats.h"
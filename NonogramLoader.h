@@ -0,0 +1,348 @@
+//Title: NonogramLoader.h
+//Description: Reads puzzles' clues from a stream
+//and builds the board and the stripes that go with them.
+//A clue file holds one or more puzzles, one after another:
+//a line with the number of rows and columns, a line of clues
+//for each row, a blank line, and a line of clues for each column.
+//An empty line (or a lone 0) is a stripe with no dark cells.
+//Numbers may be separated by spaces, tabs or commas.
+
+#ifndef NONOGRAMLOADER_H
+#define NONOGRAMLOADER_H
+
+#include "NonogramObjects.h"
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+//The biggest puzzle that gets built. The board is allocated as soon
+//as the sizes are read, so sizes past these are turned away as bad
+//clues rather than left to run the program out of memory.
+const int maxPuzzleSide = 65536;
+const long long maxPuzzleCells = 1 << 24;
+
+//One puzzle's clues, as read from the file: the lengths of all
+//the segments, rows first and then columns, and how many of
+//them belong to each stripe.
+struct PuzzleClues
+{
+   int rows, cols;
+   int line; //where the puzzle starts in its file
+   vector<int> lengths;
+   vector<int> counts;
+};
+
+//Reads puzzles from a stream a block at a time and picks the numbers
+//straight out of the block, so that big archives of puzzles (or a
+//stream of them on stdin) don't spend their time in iostream.
+class ClueReader
+{
+   private:
+   istream &in;
+   vector<char> buffer;
+   const char *pos, *end;
+   int lineNumber;
+   string message;
+
+   bool refill()
+   {
+      in.read(buffer.data(), buffer.size());
+      pos = buffer.data();
+      end = pos + in.gcount();
+      return pos < end;
+   }
+
+   //the next character, or -1 at the end of the stream
+   int peek()
+   {
+      if(pos == end && !refill())
+         return -1;
+      return (unsigned char)*pos;
+   }
+
+   //only after peek() has found a character
+   void advance()
+   {
+      if(*pos == '\n')
+         lineNumber++;
+      pos++;
+   }
+
+   void skipSpaces()
+   {
+      int c = peek();
+      while(c == ' ' || c == '\t' || c == ',' || c == '\r')
+      {
+         advance();
+         c = peek();
+      }
+   }
+
+   //reads the digits at the current position; anything too big
+   //to be a clue is cut down to a billion, which no stripe can hold anyway
+   int readNumber()
+   {
+      long long value = 0;
+      int c = peek();
+      while(c >= '0' && c <= '9')
+      {
+         if(value < 1000000000)
+            value = value * 10 + (c - '0');
+         advance();
+         c = peek();
+      }
+      return (int)min(value, (long long)1000000000);
+   }
+
+   bool fail(const string &what)
+   {
+      message = "line " + to_string(lineNumber) + ": " + what;
+      return false;
+   }
+
+   //reads the clues for stripe number "stripe", which has
+   //"length" cells, up to and including the end of its line
+   bool readClueLine(PuzzleClues &p, int stripe, int length)
+   {
+      const char *kind = (stripe < p.rows) ? "row" : "column";
+      int needed = 0;
+      while(true)
+      {
+         skipSpaces();
+         int c = peek();
+         if(c < 0)
+            return true; //the last stripes' empty lines may have been left off
+         if(c == '\n')
+         {
+            advance();
+            return true;
+         }
+         if(c < '0' || c > '9')
+            return fail(string("unexpected character '") + (char)c + "' in the clues for a " + kind);
+         int clue = readNumber();
+         if(clue == 0)
+            continue;
+         needed += clue + (p.counts[stripe] > 0 ? 1 : 0);
+         if(needed > length)
+            return fail(string("the clues need more cells than the ") + kind + " has (" + to_string(length) + ")");
+         p.lengths.push_back(clue);
+         p.counts[stripe]++;
+      }
+   }
+
+   public:
+   ClueReader(istream &input, size_t blockSize = 1 << 16) : in(input), buffer(blockSize)
+   {
+      pos = end = buffer.data();
+      lineNumber = 1;
+   }
+
+   //Reads the next puzzle. Returns false once the stream runs out of
+   //puzzles, or on a clue that doesn't make sense, in which case error()
+   //says what was wrong and where; there is no going on after that.
+   bool next(PuzzleClues &p)
+   {
+      message.clear();
+      //any number of blank lines between puzzles
+      int c = peek();
+      while(c == ' ' || c == '\t' || c == ',' || c == '\r' || c == '\n')
+      {
+         advance();
+         c = peek();
+      }
+      if(c < 0)
+         return false;
+      p.line = lineNumber;
+      p.rows = p.cols = 0;
+      p.lengths.clear();
+      if(c >= '0' && c <= '9')
+         p.rows = readNumber();
+      skipSpaces();
+      c = peek();
+      if(c >= '0' && c <= '9')
+         p.cols = readNumber();
+      skipSpaces();
+      c = peek();
+      if(p.rows <= 0 || p.cols <= 0 || (c >= 0 && c != '\n'))
+         return fail("expected the number of rows and the number of columns");
+      if(p.rows > maxPuzzleSide || p.cols > maxPuzzleSide || (long long)p.rows * p.cols > maxPuzzleCells)
+         return fail("the puzzle is too big (at most " + to_string(maxPuzzleSide) + " rows or columns and "
+                     + to_string(maxPuzzleCells) + " cells)");
+      if(c == '\n')
+         advance();
+      p.counts.assign(p.rows + p.cols, 0);
+
+      for(int i = 0; i < p.rows; i++)
+         if(!readClueLine(p, i, p.cols))
+            return false;
+      skipSpaces();
+      c = peek();
+      if(c >= 0 && c != '\n')
+         return fail("expected a blank line between the row clues and the column clues");
+      if(c == '\n')
+         advance();
+      for(int j = 0; j < p.cols; j++)
+         if(!readClueLine(p, p.rows + j, p.rows))
+            return false;
+
+      int rowCells = 0, colCells = 0, k = 0;
+      for(int i = 0; i < p.rows + p.cols; i++)
+         for(int n = 0; n < p.counts[i]; n++)
+            (i < p.rows ? rowCells : colCells) += p.lengths[k++];
+      if(rowCells != colCells)
+      {
+         lineNumber = p.line;
+         return fail("the rows have " + to_string(rowCells) + " dark cells but the columns have " + to_string(colCells));
+      }
+      return true;
+   }
+
+   //true if there are no more puzzles to read (or only blank lines)
+   bool atEnd()
+   {
+      int c = peek();
+      while(c == ' ' || c == '\t' || c == ',' || c == '\r' || c == '\n')
+      {
+         advance();
+         c = peek();
+      }
+      return c < 0;
+   }
+
+   const string& error()
+   {
+      return message;
+   }
+};
+
+//Checks clues that didn't come through a ClueReader (which checks them
+//as it reads): that there is at least one row and one column, that the
+//puzzle isn't too big to build, that every stripe's clues fit in it, and
+//that the rows and the columns have the same number of dark cells.
+//Says what is wrong in "error" if not.
+inline bool checkClues(const PuzzleClues &p, string &error)
+{
+   if(p.rows <= 0 || p.cols <= 0 || (int)p.counts.size() != p.rows + p.cols)
+   {
+      error = "expected the number of rows and the number of columns";
+      return false;
+   }
+   if(p.rows > maxPuzzleSide || p.cols > maxPuzzleSide || (long long)p.rows * p.cols > maxPuzzleCells)
+   {
+      error = "the puzzle is too big (at most " + to_string(maxPuzzleSide) + " rows or columns and "
+              + to_string(maxPuzzleCells) + " cells)";
+      return false;
+   }
+   int rowCells = 0, colCells = 0, k = 0;
+   for(int i = 0; i < p.rows + p.cols; i++)
+   {
+      const char *kind = (i < p.rows) ? "row " : "column ";
+      int length = (i < p.rows) ? p.cols : p.rows;
+      int needed = 0;
+      for(int n = 0; n < p.counts[i]; n++, k++)
+      {
+         if(k >= (int)p.lengths.size() || p.lengths[k] <= 0)
+         {
+            error = string("bad clues for ") + kind + to_string(i < p.rows ? i : i - p.rows);
+            return false;
+         }
+         needed += p.lengths[k] + (n > 0 ? 1 : 0);
+         (i < p.rows ? rowCells : colCells) += p.lengths[k];
+      }
+      if(needed > length)
+      {
+         error = string("the clues for ") + kind + to_string(i < p.rows ? i : i - p.rows)
+                 + " need more cells than it has (" + to_string(length) + ")";
+         return false;
+      }
+   }
+   if(k != (int)p.lengths.size())
+   {
+      error = "more clues than stripes to put them in";
+      return false;
+   }
+   if(rowCells != colCells)
+   {
+      error = "the rows have " + to_string(rowCells) + " dark cells but the columns have " + to_string(colCells);
+      return false;
+   }
+   return true;
+}
+
+//Builds the board and the stripes for a puzzle's clues.
+//Everything gets allocated exactly once; freePuzzle cleans up.
+//Turning off the mirror saves memory on big puzzles (see GameGrid).
+inline void buildPuzzle(const PuzzleClues &clues, RowManager &allRows, bool mirror = true)
+{
+   int numOfRows = clues.rows, numOfColumns = clues.cols;
+   GameGrid *g = new GameGrid(numOfRows,numOfColumns,mirror);
+   allRows.numOfRows = numOfRows;
+   allRows.numOfCols = numOfColumns;
+   allRows.stripes.resize(numOfRows + numOfColumns);
+   allRows.g = g;
+   allRows.mode = RULES_ONLY;
+   allRows.trail = NULL;
+   allRows.log = NULL;
+   allRows.pool = NULL;
+   allRows.cache = NULL;
+   allRows.probing = false;
+   allRows.hasDeadline = false;
+   allRows.checkLimit = 0;
+   allRows.guessLimit = 0;
+   allRows.sharedChecks = NULL;
+   allRows.segments.resize(clues.lengths.size());
+   for(size_t k = 0; k < clues.lengths.size(); k++)
+      allRows.segments[k].length = clues.lengths[k];
+   allRows.rows.reserve(numOfRows);
+   allRows.columns.reserve(numOfColumns);
+   int next = 0;
+   for(int i = 0; i < numOfRows; i++)
+   {
+      allRows.rows.emplace_back(i, numOfColumns, g);
+      allRows.rows.back().setSegments(allRows.segments.data() + next, clues.counts[i]);
+      next += clues.counts[i];
+      allRows.stripes[i] = &allRows.rows.back();
+   }
+   for(int j = 0; j < numOfColumns; j++)
+   {
+      allRows.columns.emplace_back(numOfRows, j, g);
+      allRows.columns.back().setSegments(allRows.segments.data() + next, clues.counts[numOfRows + j]);
+      next += clues.counts[numOfRows + j];
+      allRows.stripes[numOfRows + j] = &allRows.columns.back();
+   }
+}
+
+//Reads the first puzzle in the stream and builds it. Returns false if
+//the clues are missing or don't make sense (with the reason in *error,
+//if given); either way, freePuzzle cleans up afterwards.
+inline bool loadPuzzle(istream &infile, RowManager &allRows, bool mirror = true, string *error = NULL)
+{
+   ClueReader reader(infile);
+   PuzzleClues clues;
+   bool ok = reader.next(clues);
+   if(!ok)
+   {
+      if(error != NULL)
+         *error = reader.error().empty() ? "no puzzle found" : reader.error();
+      clues.rows = clues.cols = 0;
+      clues.lengths.clear();
+      clues.counts.clear();
+   }
+   buildPuzzle(clues, allRows, mirror);
+   return ok;
+}
+
+//Deletes everything loadPuzzle allocated.
+inline void freePuzzle(RowManager &allRows)
+{
+   allRows.stripes.clear();
+   allRows.rows.clear();
+   allRows.columns.clear();
+   allRows.segments.clear();
+   delete allRows.g;
+   allRows.g = NULL;
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,116 @@
+//Title: NonogramLog.h
+//Description: Progress reports from the solver, at whatever level
+//of detail was asked for. Lines are collected in a buffer and
+//written out in large pieces rather than flushed one at a time,
+//and progress lines are only written every so often, so that a
+//big puzzle doesn't spend its time waiting on the terminal.
+
+#ifndef NONOGRAMLOG_H
+#define NONOGRAMLOG_H
+
+#include <iostream>
+#include <string>
+#include <chrono>
+#include <mutex>
+
+using namespace std;
+
+//How much to report: nothing, one line per puzzle,
+//one line per pass over the stripes, or every check.
+enum LogLevel { LOG_SILENT, LOG_SUMMARY, LOG_PASSES, LOG_STEPS };
+
+class Logger
+{
+   private:
+   LogLevel level;
+   ostream &out;
+   string buffer;
+   chrono::milliseconds interval;
+   chrono::steady_clock::time_point lastProgress;
+   bool anyProgress;
+   int skipped;
+
+   //puzzles solved side by side may share the stream
+   static mutex& outputLock()
+   {
+      static mutex lock;
+      return lock;
+   }
+
+   public:
+   //progress lines closer together than progressInterval milliseconds are left out
+   Logger(LogLevel l = LOG_SILENT, ostream &o = cerr, int progressInterval = 250)
+      : level(l), out(o), interval(progressInterval)
+   {
+      anyProgress = false;
+      skipped = 0;
+   }
+
+   ~Logger()
+   {
+      flush();
+   }
+
+   //callers check this first, so that nothing is formatted for nothing
+   bool shows(LogLevel l)
+   {
+      return l <= level && level != LOG_SILENT;
+   }
+
+   //adds a line to the buffer, which is written out once it gets big
+   void write(LogLevel l, const string &line)
+   {
+      if(!shows(l))
+         return;
+      buffer += line;
+      buffer += '\n';
+      if(buffer.size() >= 65536)
+         flush();
+   }
+
+   //the same, but only if it has been a while since the last progress line;
+   //the next one that gets through says how many were left out
+   void progress(LogLevel l, const string &line)
+   {
+      if(!shows(l))
+         return;
+      chrono::steady_clock::time_point now = chrono::steady_clock::now();
+      if(anyProgress && now - lastProgress < interval)
+      {
+         skipped++;
+         return;
+      }
+      anyProgress = true;
+      lastProgress = now;
+      if(skipped > 0)
+         write(l, line + " (" + to_string(skipped) + " more not shown)");
+      else
+         write(l, line);
+      skipped = 0;
+   }
+
+   void flush()
+   {
+      if(buffer.empty())
+         return;
+      lock_guard<mutex> guard(outputLock());
+      out << buffer;
+      out.flush();
+      buffer.clear();
+   }
+};
+
+//Reads a level by name, for the command line; returns false for an unknown name.
+inline bool parseLogLevel(const string &name, LogLevel &level)
+{
+   const char *names[] = { "silent", "summary", "passes", "steps" };
+   for(int i = 0; i < 4; i++)
+      if(name == names[i])
+      {
+         level = (LogLevel)i;
+         return true;
+      }
+   return false;
+}
+
+#endif
\ No newline at end of file
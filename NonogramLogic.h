@@ -4,83 +4,122 @@
 //to solve a nonogram puzzle, assuming that each row and 
 //column has already been filled with the appropriate clues.
 
+#ifndef NONOGRAMLOGIC_H
+#define NONOGRAMLOGIC_H
+
 #include "NonogramObjects.h"
+#include "NonogramMaskSolver.h"
+#include "NonogramRuleStats.h"
 #include <iostream>
 
-void putSegmentsInOrder(NonogramStripe*);
-void accountForExistingFills(NonogramStripe*);
-void validateSegmentPositions(NonogramStripe*);
-void fillKnownSquares(NonogramStripe*);
-void emptyKnownSquares(NonogramStripe*);
-void minimumLengthCheck(NonogramStripe*);
-void step8(NonogramStripe*);
+template<class Line> bool putSegmentsInOrder(Line*);
+template<class Line> bool accountForExistingFills(Line*);
+template<class Line> bool validateSegmentPositions(Line*);
+template<class Line> bool fillKnownSquares(Line*);
+template<class Line> bool emptyKnownSquares(Line*);
+template<class Line> bool minimumLengthCheck(Line*);
+template<class Line> bool step8(Line*);
 
-void check(NonogramStripe* row)
+//Every step below is a template over the kind of stripe it works on:
+//NonogramStripe itself, going through its virtual methods, or a
+//StripeView of a row or a column, which the compiler can inline.
+//Each step is counted if NonogramRuleStats.h has been switched on.
+//A step returns false as soon as it finds a contradiction (a cell
+//that has to be both filled and empty, or a segment with nowhere
+//to go), and so does checkLine; the stripe is then left half-done.
+template<class Line>
+bool checkLine(Line* row, CheckMode mode)
 {
-   putSegmentsInOrder(row);
-   accountForExistingFills(row);
-   validateSegmentPositions(row);
-   fillKnownSquares(row);
-   emptyKnownSquares(row);
+   if (mode == LINE_SOLVER_ONLY)
+      return RUN_RULE(RULE_LINE_SOLVER, row, solveLineAuto(row));
+   if (!RUN_RULE(RULE_ORDER, row, putSegmentsInOrder(row)) ||
+       !RUN_RULE(RULE_EXISTING_FILLS, row, accountForExistingFills(row)) ||
+       !RUN_RULE(RULE_VALIDATE, row, validateSegmentPositions(row)) ||
+       !RUN_RULE(RULE_FILL_KNOWN, row, fillKnownSquares(row)) ||
+       !RUN_RULE(RULE_EMPTY_KNOWN, row, emptyKnownSquares(row)))
+      return false;
    if (!(row->isFinal()))
    {
-	   minimumLengthCheck(row);
-	   step8(row);
+	   if (!RUN_RULE(RULE_MIN_LENGTH, row, minimumLengthCheck(row)) ||
+	       !RUN_RULE(RULE_STEP8, row, step8(row)))
+		   return false;
+   }
+   if (mode == RULES_THEN_LINE_SOLVER && !(row->isFinal()))
+      return RUN_RULE(RULE_LINE_SOLVER, row, solveLineAuto(row));
+   return true;
+};
+
+//Works out once which kind of stripe this is, rather than once per cell.
+//Returns false if the stripe's clues contradict its cells.
+inline bool checkStripe(NonogramStripe* row, CheckMode mode = RULES_ONLY)
+{
+   if (NonogramRow *r = dynamic_cast<NonogramRow*>(row))
+   {
+      StripeView<NonogramRow> view(r);
+      return checkLine(&view, mode);
+   }
+   else if (NonogramColumn *c = dynamic_cast<NonogramColumn*>(row))
+   {
+      StripeView<NonogramColumn> view(c);
+      return checkLine(&view, mode);
    }
+   else
+      return checkLine(row, mode);
+};
+
+//The same, for callers that would rather catch a contradiction.
+inline void check(NonogramStripe* row, CheckMode mode = RULES_ONLY)
+{
+   if (!checkStripe(row, mode))
+      throw "Logic error!";
 };
 
 //The first and most basic check.
 //Segments must appear in the correct order,
 //and there must be at least one square separating them.
 
-void orderFromLeft(NonogramStripe* row)
+template<class Line>
+bool orderFromLeft(Line* row)
 {
-   Segment *left, *right;
-   left = row->getFirstSegment();
-   if(left != NULL) //the row could be empty
+   Segment *segs = row->getFirstSegment();
+   int count = row->getNumSegments(); //the row could be empty
+   for(int j = 1; j < count; j++)
    {
-      right = left->next;
-      while(right != NULL)
+      Segment *left = &segs[j-1], *right = &segs[j];
+	  int correctPos = left->minpos + left->length + 1;
+      if(right->minpos < correctPos)
       {
-		 int correctPos = left->minpos + left->length + 1;
-         if(right->minpos < correctPos)
-         {
-            right->minpos = correctPos;
-            if(right->maxpos < right->minpos)
-               throw "Logic error!";
-         }
-         right = right->next;
-         left = left->next;
+         right->minpos = correctPos;
+         if(right->maxpos < right->minpos)
+            return false;
       }
    }
+   return true;
 };
 
-void orderFromRight(NonogramStripe* row)
+template<class Line>
+bool orderFromRight(Line* row)
 {
-   Segment *left, *right;
-   right = row->getLastSegment();
-   if(right != NULL) //the row could be empty
+   Segment *segs = row->getFirstSegment();
+   int count = row->getNumSegments(); //the row could be empty
+   for(int j = count - 2; j >= 0; j--)
    {
-      left = right->previous;
-      while(left != NULL)
+      Segment *left = &segs[j], *right = &segs[j+1];
+	  int correctPos = right->maxpos - left->length - 1;
+      if(left->maxpos > correctPos)
       {
-		 int correctPos = right->maxpos - left->length - 1;
-         if(left->maxpos > correctPos)
-         {
-            left->maxpos = correctPos;
-            if(left->maxpos < left->minpos)
-               throw "Logic error!";
-         }
-         right = right->previous;
-         left = left->previous;
+         left->maxpos = correctPos;
+         if(left->maxpos < left->minpos)
+            return false;
       }
    }
+   return true;
 };
 
-void putSegmentsInOrder(NonogramStripe* row)
+template<class Line>
+bool putSegmentsInOrder(Line* row)
 {
-   orderFromLeft(row);
-   orderFromRight(row);
+   return orderFromLeft(row) && orderFromRight(row);
 };
 
 //If the row already contains one or more filled squares,
@@ -88,80 +127,108 @@ void putSegmentsInOrder(NonogramStripe* row)
 //For example,
 //if there is a full square at the beginning of
 //a row, anchor the first segment to it.
-void anchorLeft(NonogramStripe* row)
+template<class Line>
+bool anchorLeft(Line* row)
 {
 	int i = 0;
-	Segment* s = row->getFirstSegment();
-	while (i < row->getLength() && s != NULL)
+	Segment* segs = row->getFirstSegment();
+	int j = 0, count = row->getNumSegments();
+	while (i < row->getLength() && j < count)
 	{
-		if (i >= s->maxpos + s->length)
-			s = s->next;
+		if (i >= segs[j].maxpos + segs[j].length)
+			j++;
 		if (row->cellAt(i) == '#')
 		{
-			if (s == NULL)
-				throw "Logic error!";
+			if (j == count)
+				return false;
+			Segment* s = &segs[j];
 			if (i < s->maxpos)
 			{
 				s->maxpos = i;
 				if (s->minpos > s->maxpos)
-					throw "Logic error!";
+					return false;
 			}
 			i = s->maxpos + s->length;
 		}
 		else
 			i++;
 	}
+	return true;
 }
 
-void anchorRight(NonogramStripe* row)
+template<class Line>
+bool anchorRight(Line* row)
 {
 	int i = row->getLength() - 1;
-	Segment* s = row->getLastSegment();
-	while (i >= 0 && s != NULL)
+	Segment* segs = row->getFirstSegment();
+	int j = row->getNumSegments() - 1;
+	while (i >= 0 && j >= 0)
 	{
-		if (i < s->minpos)
-			s = s->previous;
+		if (i < segs[j].minpos)
+			j--;
 		if (row->cellAt(i) == '#')
 		{
-			if (s == NULL)
-				throw "Logic error!";
+			if (j < 0)
+				return false;
+			Segment* s = &segs[j];
 			if (i > s->minpos + s->length - 1)
 			{
 				s->minpos = i - s->length + 1;
 				if (s->minpos > s->maxpos)
-					throw "Logic error!";
+					return false;
 			}
 			i = s->minpos - 1;
 		}
 		else
 			i--;
 	}
+	return true;
 }
 
-void accountForExistingFills(NonogramStripe* row)
+template<class Line>
+bool accountForExistingFills(Line* row)
 {
-	anchorLeft(row);
-	anchorRight(row);
+	return anchorLeft(row) && anchorRight(row);
 };
 
 //Validation of each segment's placement.
 //No square within a segment may be empty,
 //and the squares immediately before and after
 //a segment may not be full.
-void validLeft(NonogramStripe* row)
+//Going from left to right, each segment is first pushed past the one
+//before it, which has just been validated, so that a segment that
+//moves only sends the ones after it along, not the whole row again.
+//A segment that hasn't moved since the last validation, with none of
+//the cells from just before it to just after it decided since (see
+//the stripe's change log), would come out where it is, so it is skipped.
+template<class Line>
+bool validLeft(Line* row)
 {
-	Segment *s = row->getFirstSegment();
-	while (s != NULL)
+	bool kept = row->logKept();
+	for (int j = 0; j < row->getNumSegments(); j++)
 	{
-		int before = s->minpos;
-		int i = before;
+		Segment *s = row->getSegment(j);
+		if (j > 0)
+		{
+			Segment *left = row->getSegment(j - 1);
+			int correctPos = left->minpos + left->length + 1;
+			if (s->minpos < correctPos)
+			{
+				s->minpos = correctPos;
+				if (s->maxpos < s->minpos)
+					return false;
+			}
+		}
+		if (kept && s->minpos == s->validMin && !row->changedBetween(s->minpos - 1, s->minpos + s->length))
+			continue;
+		int i = s->minpos;
 		while (i < s->minpos + s->length)
 		{
 			if (row->cellAt(i) == ' ')
 			{
 				s->minpos = i + 1;
 				if (s->minpos > s->maxpos)
-					throw "Logic error!";
+					return false;
 			}
 			while(row->cellAt(s->minpos + s->length) == '#')
 				s->minpos += 1;
@@ -171,18 +238,31 @@ void validLeft(NonogramStripe* row)
 			if (i < s->minpos)
 				i = s->minpos;
 		}
-		if (before != s->minpos)
-			orderFromLeft(row);
-		s = s->next;
+		s->validMin = s->minpos;
 	}
+	return true;
 }
 
-void validRight(NonogramStripe* row)
+template<class Line>
+bool validRight(Line* row)
 {
-	Segment* s = row->getLastSegment();
-	while (s != NULL)
+	bool kept = row->logKept();
+	for (int j = row->getNumSegments() - 1; j >= 0; j--)
 	{
-		int before = s->maxpos;
+		Segment* s = row->getSegment(j);
+		if (j < row->getNumSegments() - 1)
+		{
+			Segment *right = row->getSegment(j + 1);
+			int correctPos = right->maxpos - s->length - 1;
+			if (s->maxpos > correctPos)
+			{
+				s->maxpos = correctPos;
+				if (s->maxpos < s->minpos)
+					return false;
+			}
+		}
+		if (kept && s->maxpos == s->validMax && !row->changedBetween(s->maxpos - 1, s->maxpos + s->length))
+			continue;
 		int i = s->maxpos + s->length - 1;
 		while (i >= s->maxpos)
 		{
@@ -190,7 +270,7 @@ void validRight(NonogramStripe* row)
 			{
 				s->maxpos = i - s->length;
 				if (s->minpos > s->maxpos)
-					throw "Logic error!";
+					return false;
 			}
 			while (row->cellAt(s->maxpos - 1) == '#')
 				s->maxpos -= 1;
@@ -200,17 +280,20 @@ void validRight(NonogramStripe* row)
 			if (i > s->maxpos + s->length - 1)
 				i = s->maxpos + s->length - 1;
 		}
-		if (before != s->maxpos)
-			orderFromRight(row);
-		s = s->previous;
-		
+		s->validMax = s->maxpos;
 	}
+	return true;
 }
 
-void validateSegmentPositions(NonogramStripe* row)
+//Once both ways are done, every segment is where validation leaves
+//it, and the change log starts again from here.
+template<class Line>
+bool validateSegmentPositions(Line* row)
 {
-	validLeft(row);
-	validRight(row);
+	if (!validLeft(row) || !validRight(row))
+		return false;
+	row->restartLog();
+	return true;
 };
 
 //If the furthest left and the furthest right a segment
@@ -218,41 +301,46 @@ void validateSegmentPositions(NonogramStripe* row)
 //and all squares within it are filled.
 //If they are closer together than the segment's length, 
 //the overlapping squares, at least, can be filled.
-void fillKnownSquares(NonogramStripe* row)
+template<class Line>
+bool fillKnownSquares(Line* row)
 {
    //from left to right, but there is no need to do right to left as well
-   Segment *s = row->getFirstSegment();
-   while(s != NULL)
+   for(int j = 0; j < row->getNumSegments(); j++)
    {
+      Segment *s = row->getSegment(j);
       if(s->minpos == s->maxpos)
          s->placed = true;
-	  row->fill(s->maxpos, s->minpos + s->length);//if minpos = maxpos, this will fill the entire segment
-      s = s->next;
+      if(!row->fill(s->maxpos, s->minpos + s->length))//if minpos = maxpos, this will fill the entire segment
+         return false;
    }
+   return true;
 };
 
 //Empty any squares before the first segment,
 //known to be between a particular segment and the next,
 //or after the last segment.
-void emptyKnownSquares(NonogramStripe* row)
+template<class Line>
+bool emptyKnownSquares(Line* row)
 {
 	//from left to right, but there is no need to do right to left as well
-   Segment* s = row->getFirstSegment();
+   int j = 0, count = row->getNumSegments();
    int i = 0;
    while(i < row->getLength())
    {
 	   int last;
-	   if (s == NULL)
+	   if (j == count)
 		   last = row->getLength();
 	   else
-		   last = s->minpos;
-	   row->empty(i,last);
-	   if (s == NULL)
+		   last = row->getSegment(j)->minpos;
+	   if (!row->empty(i,last))
+		   return false;
+	   if (j == count)
 		   break;
-	   i = s->maxpos + s->length;
-	   s = s->next;
+	   i = row->getSegment(j)->maxpos + row->getSegment(j)->length;
+	   j++;
 	   
    }
+   return true;
 };
 
 //The "minimum length" step.
@@ -263,89 +351,101 @@ void emptyKnownSquares(NonogramStripe* row)
 //that the minimum length will be met.
 
 //Finds minimum length of any segment within range.
-int minLengthOverall(Segment* firstSeg, int start, int end) {
-	int result = firstSeg->length;
-	Segment* s = firstSeg->next;
-	while (s != NULL) {
+template<class Line>
+int minLengthOverall(Line* row, int firstSeg, int start, int end) {
+	int result = row->getSegment(firstSeg)->length;
+	for (int j = firstSeg + 1; j < row->getNumSegments(); j++) {
+		Segment* s = row->getSegment(j);
 		if (s->minpos > end) 
 			break;
 		if (s->length < result)
 			result = s->length;
-		s = s->next;
 	}
 	return result;
 }
 
-//Finds minimum length of the first segment within range.
-int minLengthLeft(Segment* firstSeg, int start) {
-	int result = firstSeg->length;
-	Segment* s = firstSeg->next;
-	while (s != NULL) {
-		if (s->minpos > start)
+//Finds minimum length of any segment that could cover
+//the filled square at pos, looking from the left.
+template<class Line>
+int minLengthLeft(Line* row, int firstSeg, int pos) {
+	int result = row->getSegment(firstSeg)->length;
+	for (int j = firstSeg + 1; j < row->getNumSegments(); j++) {
+		Segment* s = row->getSegment(j);
+		if (s->minpos > pos)
 			break;
 		if(s->length < result)
 			result = s->length;
-		s = s->next;
 	}
 	return result;
 }
 
-//Finds minimum length of the last segment within range.
-int minLengthRight(Segment* firstSeg, int end) {
-	Segment* s = firstSeg;
-	while (s->maxpos < end - s->length)
-		s = s->next; //should not result in null pointer; if some segment can't go there, square should already be empty
-	int result = s->length;
-	s = s->next;
-	while (s != NULL)
+//Finds minimum length of any segment that could cover
+//the filled square at pos, looking from the right.
+template<class Line>
+int minLengthRight(Line* row, int firstSeg, int pos) {
+	int j = firstSeg;
+	while (row->getSegment(j)->maxpos + row->getSegment(j)->length <= pos)
+		j++; //should not run off the end; some segment has to cover a filled square
+	int result = row->getSegment(j)->length;
+	for (j++; j < row->getNumSegments(); j++)
 	{
-		if (s->minpos <= end)
+		Segment* s = row->getSegment(j);
+		if (s->minpos > pos)
 			break;
 		if(s->length < result)
 			result = s->length;
-		s = s->next;
 	}
 	return result;
 }
 
 //Put it all together now
-void minimumLengthCheck(NonogramStripe* row)
+template<class Line>
+bool minimumLengthCheck(Line* row)
 {
 	int i = 0;
-	Segment *firstAvailable = row->getFirstSegment();
+	int firstAvailable = 0;
 	while (i < row->getLength())
 	{
 		if (row->cellAt(i) == ' ')
 			i++;
 		else
 		{
-			while (i > firstAvailable->maxpos)
-				firstAvailable = firstAvailable->next;
+			while (i > row->getSegment(firstAvailable)->maxpos)
+				firstAvailable++;
 			int minLength, start, end;
 			start = i;
 			while (row->cellAt(i) != ' ')
 				i++;
 			end = i;
-			minLength = minLengthOverall(firstAvailable,start,end);
+			minLength = minLengthOverall(row, firstAvailable, start, end);
 			if (end - start + 1 < minLength)//empty any intervening spaces
-				row->empty(start, end + 1);
+			{
+				if (!row->empty(start, end + 1))
+					return false;
+			}
 			else if (minLength > 1)//ensure minimum length will be fulfilled
 			{
-				//first, from left to right
-				minLength = minLengthLeft(firstAvailable,start);
+				//first, from left to right: whichever segment covers
+				//the first filled square has to reach this far
 				int j = start;
-				while (row->cellAt(j) != '#' && j < start + minLength)
+				while (j < end && row->cellAt(j) != '#')
 					j++;
-				row->fill(j, start + minLength);
+				if (j == end)
+					continue; //nothing filled here yet
+				minLength = minLengthLeft(row, firstAvailable, j);
+				if (!row->fill(j, start + minLength))
+					return false;
 				//then, from right to left
-				minLength = minLengthRight(firstAvailable, end);
-				j = end;
-				while (row->cellAt(j) != '#' && j >= end - minLength)
+				j = end - 1;
+				while (row->cellAt(j) != '#')
 					j--;
-				row->fill(end - minLength, j);
+				minLength = minLengthRight(row, firstAvailable, j);
+				if (!row->fill(end - minLength, j))
+					return false;
 			}
 		}
 	}
+	return true;
 };
 
 //Step 8: The "Maximum Length" step.
@@ -359,10 +459,13 @@ void minimumLengthCheck(NonogramStripe* row)
 //if the filled segment is at its left end, then the square just
 //before the filled segment (but not the one after it) can be emptied.
 //Same goes from the right.
-void step8(NonogramStripe* row)
+template<class Line>
+bool step8(Line* row)
 {
    int i = 0;
-   Segment *firstAvailable = row->getFirstSegment();
+   int count = row->getNumSegments();
+   Segment *segs = row->getFirstSegment();
+   Segment *firstAvailable = segs;
    while(i < row->getLength())
    {
       if(row->cellAt(i) != '#')
@@ -370,7 +473,7 @@ void step8(NonogramStripe* row)
       else //filled square is encountered
       {
          while(i > firstAvailable->maxpos + firstAvailable->length - 1)
-            firstAvailable = firstAvailable->next;
+            firstAvailable++;
          int maxLength, start, end;
          start = i;
          //first, find out how many filled squares in a row there are
@@ -379,47 +482,48 @@ void step8(NonogramStripe* row)
          end = i;
          //next, find out the maximum length of the available segments
          maxLength = firstAvailable->length;
-         Segment *s = firstAvailable->next;
-         while(s != NULL)
+         for(Segment *s = firstAvailable + 1; s < segs + count; s++)
          {
             //Step 9 as performed from left to right
-            if(s->minpos == start && end - start == maxLength)
-               row->empty(start - 1);
+            if(s->minpos == start && end - start == maxLength && !row->empty(start - 1))
+               return false;
             if(s->minpos < end && s->length > maxLength)
                maxLength = s->length;
-            s = s->next;
          }
          if(end - start == maxLength)//empty spaces before and after
          {
-            row->empty(end);
-            row->empty(start-1);
+            if(!row->empty(end))
+               return false;
+            if(!row->empty(start-1))
+               return false;
          }
          else if(row->cellAt(end) != ' ')//see if filling next square will join two segments, exceeding length
          {
             int newEnd = end + 1;
             while(row->cellAt(newEnd) == '#')
                newEnd++;
-            if(newEnd-start > maxLength)
-               row->empty(end);
+            if(newEnd-start > maxLength && !row->empty(end))
+               return false;
          }
          //Step 9, as performed from right to left
          if(firstAvailable->maxpos + firstAvailable->length == end)
          {
-            Segment *s = firstAvailable->next;
-            if(s != NULL)
+            if(firstAvailable + 1 < segs + count)
             {
-               maxLength = s->length;
-               while(s != NULL)
+               maxLength = firstAvailable[1].length;
+               for(Segment *s = firstAvailable + 1; s < segs + count; s++)
                {
                   if(s->minpos < end && s->length > maxLength)
                      maxLength = s->length;
-                  s = s->next;
                }
-               if(end - start == maxLength)
-                  row->empty(end);
+               if(end - start == maxLength && !row->empty(end))
+                  return false;
                
             }
          }
       }
    }
+   return true;
 };
+
+#endif
\ No newline at end of file
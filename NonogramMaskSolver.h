@@ -0,0 +1,306 @@
+//Title: NonogramMaskSolver.h
+//Description: The exact line solver again, for stripes short enough
+//to keep a whole line in a word or two. It works out exactly what
+//solveLine() does, but instead of a table with a cell for every
+//segment and position, it keeps one bit mask per segment with a bit
+//for every position, and builds each mask from the last one with a
+//few shifts, ands and ors. Most puzzles are no more than 64 cells
+//across, and for those every mask is a single uint64_t.
+//solveLineAuto() picks this solver for any stripe that fits in it and
+//solveLine() for the rest; checkLine() goes through it.
+
+#ifndef NONOGRAMMASKSOLVER_H
+#define NONOGRAMMASKSOLVER_H
+
+#include "NonogramObjects.h"
+#include "NonogramLineSolver.h"
+#include <stdint.h>
+
+using namespace std;
+
+//One bit for each cell of a line of up to MaxWidth cells, cell 0 in the lowest bit.
+template<int MaxWidth>
+struct LineMask
+{
+   static const int words = (MaxWidth + 63) / 64;
+   uint64_t w[words];
+
+   static LineMask none()
+   {
+      LineMask m;
+      for(int i = 0; i < words; i++)
+         m.w[i] = 0;
+      return m;
+   }
+
+   //cells 0 through n-1
+   static LineMask first(int n)
+   {
+      LineMask m;
+      for(int i = 0; i < words; i++)
+         m.w[i] = bitRange(0, min(max(n - i * 64, 0), 64));
+      return m;
+   }
+
+   static LineMask bit(int i)
+   {
+      LineMask m = none();
+      m.w[i >> 6] = (uint64_t)1 << (i & 63);
+      return m;
+   }
+
+   LineMask operator&(const LineMask &o) const
+   {
+      LineMask m;
+      for(int i = 0; i < words; i++)
+         m.w[i] = w[i] & o.w[i];
+      return m;
+   }
+
+   LineMask operator|(const LineMask &o) const
+   {
+      LineMask m;
+      for(int i = 0; i < words; i++)
+         m.w[i] = w[i] | o.w[i];
+      return m;
+   }
+
+   LineMask andNot(const LineMask &o) const
+   {
+      LineMask m;
+      for(int i = 0; i < words; i++)
+         m.w[i] = w[i] & ~o.w[i];
+      return m;
+   }
+
+   //every bit moved s cells to the right (up), or to the left (down)
+   LineMask up(int s) const
+   {
+      LineMask m;
+      int whole = s >> 6, part = s & 63;
+      for(int i = words - 1; i >= 0; i--)
+      {
+         uint64_t word = (i - whole >= 0) ? w[i - whole] << part : 0;
+         if(part > 0 && i - whole - 1 >= 0)
+            word |= w[i - whole - 1] >> (64 - part);
+         m.w[i] = word;
+      }
+      return m;
+   }
+
+   LineMask down(int s) const
+   {
+      LineMask m;
+      int whole = s >> 6, part = s & 63;
+      for(int i = 0; i < words; i++)
+      {
+         uint64_t word = (i + whole < words) ? w[i + whole] >> part : 0;
+         if(part > 0 && i + whole + 1 < words)
+            word |= w[i + whole + 1] << (64 - part);
+         m.w[i] = word;
+      }
+      return m;
+   }
+
+   //The line read from the other end: cell i of an n-cell line goes to n-1-i.
+   LineMask reversed(int n) const
+   {
+      LineMask m;
+      for(int i = 0; i < words; i++)
+      {
+         uint64_t x = w[words - 1 - i];
+         x = ((x >> 1) & 0x5555555555555555ULL) | ((x & 0x5555555555555555ULL) << 1);
+         x = ((x >> 2) & 0x3333333333333333ULL) | ((x & 0x3333333333333333ULL) << 2);
+         x = ((x >> 4) & 0x0F0F0F0F0F0F0F0FULL) | ((x & 0x0F0F0F0F0F0F0F0FULL) << 4);
+         m.w[i] = __builtin_bswap64(x);
+      }
+      return m.down(words * 64 - n);
+   }
+
+   bool get(int i) const
+   {
+      return (w[i >> 6] >> (i & 63)) & 1;
+   }
+
+   bool isEmpty() const
+   {
+      for(int i = 0; i < words; i++)
+         if(w[i] != 0)
+            return false;
+      return true;
+   }
+
+   //the first cell from "from" on whose bit is "value", or -1 if there is none
+   int next(int from, bool value) const
+   {
+      for(int i = from >> 6; i < words; i++)
+      {
+         uint64_t word = value ? w[i] : ~w[i];
+         if(i == from >> 6)
+            word &= ~(uint64_t)0 << (from & 63);
+         if(word != 0)
+            return i * 64 + __builtin_ctzll(word);
+      }
+      return -1;
+   }
+
+   int highest() const
+   {
+      for(int i = words - 1; i >= 0; i--)
+         if(w[i] != 0)
+            return i * 64 + 63 - __builtin_clzll(w[i]);
+      return -1;
+   }
+};
+
+//Every cell that can be reached from one of the seeds by moving right
+//through cells in "pass" (each step lands on a cell in it), the seeds
+//included. Takes one shift per doubling of the distance, rather than
+//one per cell.
+template<int MaxWidth>
+LineMask<MaxWidth> spreadRight(LineMask<MaxWidth> seeds, LineMask<MaxWidth> pass)
+{
+   for(int s = 1; s < MaxWidth; s *= 2)
+   {
+      seeds = seeds | (pass & seeds.up(s));
+      pass = pass & pass.up(s);
+   }
+   return seeds;
+}
+
+//What packing the segments into a line from its left end found.
+//fits[j] has bit i set if the first j segments fit in cells 0 to i,
+//with every dark cell there covered; starts[j] has the cells that
+//segment j can start at, as far as the cells before it go; and
+//ends[j] has the cells that segment j can end at, as far as its own
+//cells go (none of them light).
+template<int MaxWidth>
+struct MaskPass
+{
+   static const int maxSegments = (MaxWidth + 1) / 2;
+   LineMask<MaxWidth> fits[maxSegments + 1], starts[maxSegments], ends[maxSegments];
+};
+
+template<int MaxWidth>
+void packFromLeft(int n, int k, const int *lengths, const LineMask<MaxWidth> &dark,
+                  const LineMask<MaxWidth> &light, MaskPass<MaxWidth> &pass)
+{
+   typedef LineMask<MaxWidth> Mask;
+   Mask all = Mask::first(n);
+   Mask canBeLight = all.andNot(dark), canBeDark = all.andNot(light);
+   pass.fits[0] = spreadRight(Mask::bit(0) & canBeLight, canBeLight);
+   for(int j = 0; j < k; j++)
+   {
+      int length = lengths[j];
+      //the cell before a segment has to be light, and the
+      //segments before that have to fit in the cells before it
+      if(j == 0)
+         pass.starts[j] = (Mask::bit(0) | pass.fits[0].up(1)) & all;
+      else
+         pass.starts[j] = pass.fits[j].up(2) & canBeLight.up(1) & all;
+      Mask run = canBeDark;
+      for(int t = 1; t < length; t++)
+         run = run & canBeDark.up(t);
+      pass.ends[j] = run;
+      pass.fits[j + 1] = spreadRight(pass.starts[j].up(length - 1) & run, canBeLight);
+   }
+}
+
+//Solves a stripe of up to MaxWidth cells the way solveLine() does, with
+//the same result: the same cells decided, in the same order, and the
+//same bounds for every segment. Returns false if the segments can't be
+//placed at all.
+template<int MaxWidth, class Line>
+bool solveLineMasks(Line* row)
+{
+   typedef LineMask<MaxWidth> Mask;
+   int n = row->getLength();
+   int k = row->getNumSegments();
+   if(k > MaskPass<MaxWidth>::maxSegments)
+      return false; //every segment takes a cell and a gap
+   int lengths[MaskPass<MaxWidth>::maxSegments], reversedLengths[MaskPass<MaxWidth>::maxSegments];
+   for(int j = 0; j < k; j++)
+   {
+      lengths[j] = row->getSegment(j)->length;
+      reversedLengths[k - 1 - j] = lengths[j];
+   }
+   Mask dark = Mask::none(), light = Mask::none();
+   for(int i = 0; i < n; i += 64)
+      readCells(row, i, dark.w[i >> 6], light.w[i >> 6]);
+
+   //Segments packed in from the left, and then from the right by doing
+   //the same to the line read backwards. Between them they say, for
+   //every segment and cell, whether the segments on either side fit.
+   static thread_local MaskPass<MaxWidth> left, right;
+   packFromLeft(n, k, lengths, dark, light, left);
+   if(!left.fits[k].get(n - 1))
+      return false;
+   packFromLeft(n, k, reversedLengths, dark.reversed(n), light.reversed(n), right);
+
+   //Where each segment can start in some complete placement; the
+   //cells it covers from there could be dark.
+   Mask all = Mask::first(n);
+   Mask canFill = Mask::none();
+   for(int j = 0; j < k; j++)
+   {
+      int length = lengths[j];
+      Mask fitsAfter = right.starts[k - 1 - j].reversed(n); //by the cell the segment ends at
+      Mask starts = left.starts[j] & (left.ends[j] & fitsAfter).down(length - 1);
+      Segment *s = row->getSegment(j);
+      s->minpos = starts.next(0, true);
+      s->maxpos = starts.highest();
+      if(s->minpos == s->maxpos)
+         s->placed = true;
+      Mask covered = starts;
+      for(int t = 1; t < length; t++)
+         covered = covered | starts.up(t);
+      canFill = canFill | covered;
+   }
+
+   //A cell that isn't dark can be light if it lies in the gap after
+   //segment j-1 (or before the first one) in some complete placement:
+   //the first j segments fit before it and the rest after it.
+   Mask canEmpty = Mask::none();
+   for(int j = 0; j <= k; j++)
+   {
+      Mask before = left.fits[j].up(1), after = right.fits[k - j].up(1);
+      if(j == 0)
+         before = before | Mask::bit(0);
+      if(j == k)
+         after = after | Mask::bit(0);
+      canEmpty = canEmpty | (before & after.reversed(n));
+   }
+   canEmpty = canEmpty & all.andNot(dark);
+
+   //write the new cells back a run at a time, left to right
+   Mask newDark = canFill.andNot(canEmpty).andNot(dark);
+   Mask newLight = all.andNot(canFill).andNot(light);
+   Mask decided = newDark | newLight;
+   int i = decided.next(0, true);
+   while(i >= 0 && i < n)
+   {
+      bool filling = newDark.get(i);
+      int end = (filling ? newDark : newLight).next(i, false);
+      if(end < 0 || end > n)
+         end = n;
+      if(filling ? !row->fill(i, end) : !row->empty(i, end))
+         return false;
+      i = decided.next(end, true);
+   }
+   return true;
+}
+
+//The mask solver for a stripe that fits in one, and solveLine() for
+//anything longer.
+template<class Line>
+bool solveLineAuto(Line* row)
+{
+   if(row->getLength() <= 64)
+      return solveLineMasks<64>(row);
+   else if(row->getLength() <= 128)
+      return solveLineMasks<128>(row);
+   else
+      return solveLine(row);
+}
+
+#endif
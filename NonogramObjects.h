@@ -8,29 +8,154 @@
 #define NONOGRAMOBJECTS_H
 
 #include <vector>
+#include <deque>
 #include <iostream>
 #include <fstream>
+#include <algorithm>
+#include <chrono>
+#include <atomic>
+#include <stdint.h>
 
 using namespace std;
 
+//Mask of bits lo through hi-1 of a 64-bit word.
+inline uint64_t bitRange(int lo, int hi)
+{
+   uint64_t upper = (hi >= 64) ? ~(uint64_t)0 : (((uint64_t)1 << hi) - 1);
+   return upper & ~(((uint64_t)1 << lo) - 1);
+}
+
 class GameGrid //the grid of cells, each full, empty, or undecided as yet
 {
    private: 
-      vector<vector<char> > grid;
-      int numOfRows,numOfCols;
+      //two bit planes, one bit per cell: "filled" is set for '#', "emptied" for ' ';
+      //a cell with neither bit set is still undecided ('-').
+      //Each row takes up rowWords consecutive words of each plane.
+      vector<uint64_t> filled, emptied;
+      //The same two planes again, transposed, unless the grid was made
+      //without its mirror: each column takes up colWords consecutive
+      //words, so a column's cells sit side by side just like a row's.
+      vector<uint64_t> colFilled, colEmptied;
+      int numOfRows,numOfCols,rowWords,colWords;
+      bool mirrored;
+      
+      //Sets (or clears) the transposed bit of every cell of the given
+      //row whose bit is set in "bits" (within word number "word" of that row).
+      void mirrorRow(vector<uint64_t> &plane, int row, int word, uint64_t bits, bool set)
+      {
+         uint64_t bit = (uint64_t)1 << (row & 63);
+         while(bits != 0)
+         {
+            int w = (word*64 + __builtin_ctzll(bits)) * colWords + (row >> 6);
+            if(set)
+               plane[w] |= bit;
+            else
+               plane[w] &= ~bit;
+            bits &= bits - 1;
+         }
+      }
    
    public: 
-   GameGrid(int rows, int columns)
+   //one word's worth of cells decided at once, as recorded for undoing later
+   struct Change
    {
-      grid.resize(rows);
-      for(int i = 0; i<rows; i++)
-      {
-         grid[i].resize(columns);
-         for(int j = 0; j<columns; j++)
-            grid[i][j] = 45; //minus sign for undecided; leaves spacebar free for empty, producing clearer picture in the end
-      }
+      int word;
+      uint64_t bits;
+      bool wasFill;
+   };
+   vector<Change> *trail; //when set, every change gets logged here
+   
+   //Without the mirror the grid takes half the memory,
+   //but reading a column means jumping from row to row.
+   GameGrid(int rows, int columns, bool mirror = true)
+   {
+      trail = NULL;
       numOfRows = rows;
       numOfCols = columns;
+      rowWords = (columns + 63) / 64;
+      colWords = (rows + 63) / 64;
+      mirrored = mirror;
+      filled.assign(rows * rowWords, 0);
+      emptied.assign(rows * rowWords, 0);
+      if(mirrored)
+      {
+         colFilled.assign(columns * colWords, 0);
+         colEmptied.assign(columns * colWords, 0);
+      }
+   }
+   
+   int getRows()
+   {
+      return numOfRows;
+   }
+   
+   int getColumns()
+   {
+      return numOfCols;
+   }
+   
+   bool isMirrored()
+   {
+      return mirrored;
+   }
+   
+   //bytes taken up by the bit planes
+   size_t memoryUsed()
+   {
+      return (filled.size() + emptied.size() + colFilled.size() + colEmptied.size()) * sizeof(uint64_t);
+   }
+   
+   //The bit planes, for reading cells without going through cell():
+   //cell (row, column) is bit number bitIndex(row, column) of each,
+   //counting from bit 0 of the first word.
+   const uint64_t* filledPlane()
+   {
+      return filled.data();
+   }
+   
+   const uint64_t* emptiedPlane()
+   {
+      return emptied.data();
+   }
+   
+   size_t bitIndex(int row, int column)
+   {
+      return (size_t)row * rowWords * 64 + column;
+   }
+   
+   int getRowWords()
+   {
+      return rowWords;
+   }
+   
+   //The same for the mirror, if there is one:
+   //cell (row, column) is bit number columnBitIndex(row, column).
+   const uint64_t* columnFilledPlane()
+   {
+      return colFilled.data();
+   }
+   
+   const uint64_t* columnEmptiedPlane()
+   {
+      return colEmptied.data();
+   }
+   
+   size_t columnBitIndex(int row, int column)
+   {
+      return (size_t)column * colWords * 64 + row;
+   }
+   
+   //no bounds check; the caller has already made sure the cell is on the grid
+   char cell(int row, int column)
+   {
+      int word = row * rowWords + (column >> 6);
+      uint64_t bit = (uint64_t)1 << (column & 63);
+      if(filled[word] & bit)
+         return '#';
+      else if(emptied[word] & bit)
+         return ' ';
+      else
+         return '-'; //minus sign for undecided; leaves spacebar free for empty, producing clearer picture in the end
    }
    
    char at(int row, int column)
@@ -38,55 +163,156 @@ class GameGrid //the grid of cells, each full, empty, or undecided as yet
       if(row<0 || column<0 || row >= numOfRows || column >= numOfCols)
          return ' ';//squares outside grid are considered empty
       else
-         return grid[row][column];
+         return cell(row, column);
    }
    
    void fill(int row, int column)
    {
+      uint64_t changed;
       if(row<0 || column<0 || row >= numOfRows || column >= numOfCols)
          throw "Out of bounds error!";
-      else if(grid[row][column]==32)//space
+      if(!fillBits(row, column >> 6, (uint64_t)1 << (column & 63), changed))
          throw "Logic error!";
-      else
-         grid[row][column]=35;//#
    }
    
    void empty(int row, int column)
    {
+      uint64_t changed;
       if(row<0 || column<0 || row >= numOfRows || column >= numOfCols); // squares outside the grid are already considered empty; this can happen when finalizing segments
-      else if(grid[row][column]==35)//#
+      else if(!emptyBits(row, column >> 6, (uint64_t)1 << (column & 63), changed))
          throw "Logic error!";
+   }
+   
+   //Word-level versions of fill and empty: every cell of the given row
+   //whose bit is set in mask (within word number "word" of that row) is
+   //filled or emptied at once, and "changed" gets the bits that were not
+   //already set. If any of those cells has already been decided the other
+   //way, that's a contradiction: nothing changes, and the result is false.
+   bool fillBits(int row, int word, uint64_t mask, uint64_t &changed)
+   {
+      int w = row * rowWords + word;
+      if(emptied[w] & mask)
+         return false;
+      changed = mask & ~filled[w];
+      filled[w] |= mask;
+      if(mirrored)
+         mirrorRow(colFilled, row, word, changed, true);
+      if(trail != NULL && changed != 0)
+      {
+         Change c = { w, changed, true };
+         trail->push_back(c);
+      }
+      return true;
+   }
+   
+   bool emptyBits(int row, int word, uint64_t mask, uint64_t &changed)
+   {
+      int w = row * rowWords + word;
+      if(filled[w] & mask)
+         return false;
+      changed = mask & ~emptied[w];
+      emptied[w] |= mask;
+      if(mirrored)
+         mirrorRow(colEmptied, row, word, changed, true);
+      if(trail != NULL && changed != 0)
+      {
+         Change c = { w, changed, false };
+         trail->push_back(c);
+      }
+      return true;
+   }
+   
+   //The same for part of a column, a word of the mirror at a time;
+   //only for a grid that has its mirror. The cells also change in
+   //the row-major planes, where each one is in a word of its own.
+   bool fillColumnBits(int column, int word, uint64_t mask, uint64_t &changed)
+   {
+      return setColumnBits(colFilled, colEmptied, filled, true, column, word, mask, changed);
+   }
+   
+   bool emptyColumnBits(int column, int word, uint64_t mask, uint64_t &changed)
+   {
+      return setColumnBits(colEmptied, colFilled, emptied, false, column, word, mask, changed);
+   }
+   
+   //Makes this grid's cells the same as another's of the same size;
+   //the trail is left alone.
+   void copyCells(const GameGrid &other)
+   {
+      filled = other.filled;
+      emptied = other.emptied;
+      colFilled = other.colFilled;
+      colEmptied = other.colEmptied;
+   }
+   
+   //puts the cells of a logged change back to undecided
+   void undo(const Change &c)
+   {
+      if(c.wasFill)
+         filled[c.word] &= ~c.bits;
       else
-         grid[row][column]=32;//space
+         emptied[c.word] &= ~c.bits;
+      if(mirrored)
+         mirrorRow(c.wasFill ? colFilled : colEmptied, c.word / rowWords, c.word % rowWords, c.bits, false);
    }
+   
    void print()
    {
       for(int i = 0; i<numOfRows; i++)
       {
          for(int j = 0; j<numOfCols; j++)
-            cout << grid[i][j];
+            cout << cell(i, j);
          cout << endl;
       }
    }
+   //the whole picture is put together first and written in one go
    void printToFile(string filename)
    {
-      ofstream outfile;
-      outfile.open(filename.c_str());
+      string picture;
+      picture.reserve((size_t)numOfRows * (numOfCols + 1));
       for(int i = 0; i<numOfRows; i++)
       {
          for(int j = 0; j<numOfCols; j++)
-            outfile << grid[i][j];
-         outfile << endl;
+            picture += cell(i, j);
+         picture += '\n';
       }
+      ofstream outfile;
+      outfile.open(filename.c_str());
+      outfile.write(picture.data(), picture.size());
       outfile.close();
    }
+   
+   private:
+   bool setColumnBits(vector<uint64_t> &plane, vector<uint64_t> &other, vector<uint64_t> &rowPlane,
+                      bool isFill, int column, int word, uint64_t mask, uint64_t &changed)
+   {
+      int w = column * colWords + word;
+      if(other[w] & mask)
+         return false;
+      changed = mask & ~plane[w];
+      plane[w] |= mask;
+      uint64_t bit = (uint64_t)1 << (column & 63);
+      for(uint64_t bits = changed; bits != 0; bits &= bits - 1)
+      {
+         int rw = (word*64 + __builtin_ctzll(bits)) * rowWords + (column >> 6);
+         rowPlane[rw] |= bit;
+         if(trail != NULL)
+         {
+            Change c = { rw, bit, isFill };
+            trail->push_back(c);
+         }
+      }
+      return true;
+   }
 };
 
 struct Segment //a "dark" segment, as given by one of the clues
 {
   int length, minpos, maxpos;
   bool placed;
-  Segment *previous, *next; 
+  //where validLeft and validRight last left minpos and maxpos; they
+  //only mean anything while the stripe's change log is being kept
+  int validMin, validMax;
 };
 
 class NonogramStripe //to include both rows and columns, as implemented below
@@ -94,43 +320,95 @@ class NonogramStripe //to include both rows and columns, as implemented below
    protected:
    GameGrid *board;
    int stripelength;
-   Segment *first;
+   Segment *segments; //this stripe's clues, in order; they live in RowManager::segments
+   int numSegments;
    bool finalized;
    
    public:
    bool modified;
+   int trailStamp; //last trail level this stripe's segments were saved at
+   vector<int> changes; //positions this stripe has decided since the scheduler last collected them
+   //The cells of this stripe decided since its segments were last
+   //validated, one bit each, whichever stripe decided them. The
+   //scheduler notes them as it collects changes (see collectChanges);
+   //anything that puts cells back without noting them (the trail, or
+   //copying a board) has to drop the log, and until the next
+   //validation it isn't kept, and every segment is looked at again.
+   vector<uint64_t> changeLog;
+   bool keepingLog;
+   //Filling and emptying return false if a cell has already been decided
+   //the other way; that's a contradiction, and the stripe is left as it
+   //was, apart from any earlier cells of a range that were already done.
    virtual char cellAt(int position) = 0;
-   virtual void fill(int position) = 0;
-   void fill(int start, int end) {
+   virtual bool fill(int position) = 0;
+   virtual bool fill(int start, int end) {
 	   for (int ii = start; ii < end; ii++)
-		   this->fill(ii);
+		   if (!this->fill(ii))
+			   return false;
+	   return true;
    }
-   virtual void empty(int position) = 0;
-   void empty(int start, int end) {
+   virtual bool empty(int position) = 0;
+   virtual bool empty(int start, int end) {
 	   for (int ii = start; ii < end; ii++)
-		   this->empty(ii);
+		   if (!this->empty(ii))
+			   return false;
+	   return true;
    }
    
-   void add(Segment *nextSeg)
+   //hands this stripe its clues, which must already have their lengths set
+   void setSegments(Segment *first, int count)
    {
-      nextSeg->minpos = 0;
-      nextSeg->maxpos = stripelength - nextSeg->length;
-      nextSeg->placed = false;
-      if(first==NULL)
+      segments = first;
+      numSegments = count;
+      for(int i = 0; i < count; i++)
       {
-         nextSeg->previous = NULL;
-         nextSeg->next = NULL;
-         first = nextSeg;
-      }
-      else
-      {
-         Segment *i = first;
-         while(i->next != NULL)
-            i = i->next;
-         i->next = nextSeg;
-         nextSeg->previous = i;
-         nextSeg->next = NULL;
+         segments[i].minpos = 0;
+         segments[i].maxpos = stripelength - segments[i].length;
+         segments[i].placed = false;
+         segments[i].validMin = segments[i].validMax = -1;
       }
+      keepingLog = false;
+   }
+   
+   void noteChange(int position)
+   {
+      changeLog[position >> 6] |= (uint64_t)1 << (position & 63);
+   }
+   
+   //true if any cell from "from" to "to" (both included, and either
+   //may be off the end of the stripe) is in the change log
+   bool changedBetween(int from, int to)
+   {
+      from = max(from, 0);
+      to = min(to, stripelength - 1);
+      if(from > to)
+         return false;
+      int first = from >> 6, last = to >> 6;
+      if(first == last)
+         return (changeLog[first] & bitRange(from & 63, (to & 63) + 1)) != 0;
+      if(changeLog[first] & bitRange(from & 63, 64))
+         return true;
+      for(int w = first + 1; w < last; w++)
+         if(changeLog[w] != 0)
+            return true;
+      return (changeLog[last] & bitRange(0, (to & 63) + 1)) != 0;
+   }
+   
+   //starts the log again, once every segment has been validated
+   void restartLog()
+   {
+      changeLog.assign(changeLog.size(), 0);
+      keepingLog = true;
+   }
+   
+   bool logKept()
+   {
+      return keepingLog;
+   }
+   
+   void dropLog()
+   {
+      keepingLog = false;
    }
    
    int getLength()
@@ -138,19 +416,40 @@ class NonogramStripe //to include both rows and columns, as implemented below
       return stripelength;
    }
    
+   bool getFinalized()
+   {
+      return finalized;
+   }
+   
+   void setFinalized(bool f)
+   {
+      finalized = f;
+   }
+   
+   int getNumSegments()
+   {
+      return numSegments;
+   }
+   
+   Segment* getSegment(int i)
+   {
+      return segments + i;
+   }
+   
+   //how many cells this stripe has decided since the scheduler last looked
+   size_t changeCount()
+   {
+      return changes.size();
+   }
+   
    Segment* getFirstSegment()
    {
-      return first;
+      return numSegments > 0 ? segments : NULL;
    }
    
    Segment* getLastSegment()
    {
-      Segment* result = first;
-      if(result==NULL)
-         return result;
-      while(result->next != NULL)
-         result = result->next;
-      return result;
+      return numSegments > 0 ? segments + numSegments - 1 : NULL;
    }
    
    bool isFinal()
@@ -158,34 +457,26 @@ class NonogramStripe //to include both rows and columns, as implemented below
       if(finalized)
          return true;
       bool result = true;
-      Segment *i = first;
-      while(i != NULL && result)
+      for(int i = 0; i < numSegments && result; i++)
       {
-         if(!(i->placed))
+         if(!(segments[i].placed))
             result = false;
-         i = i->next;
       }
       if(result)
          finalized = true;
       return result;
    }
    
-   //destructor; deletes all the segments this row contains, as segments are meaningless outside a row
-   ~NonogramStripe()
+   //the segments belong to the RowManager, which frees them all at once
+   virtual ~NonogramStripe()
    {
-      cout << "Row deleted." <<endl;
-      Segment *i = first;
-      Segment *j;
-      while(i != NULL)
-      {
-         j = i;
-         i = i->next;
-         delete j;
-      }
    }
 };
 
-class NonogramRow: public NonogramStripe
+//NonogramRow and NonogramColumn are final, so that code which knows
+//which of the two it has (such as the StripeView below) calls their
+//methods directly instead of through the virtual table.
+class NonogramRow final: public NonogramStripe
 {
    private:
    int rowNumber;
@@ -196,9 +487,13 @@ class NonogramRow: public NonogramStripe
       rowNumber = row;
       stripelength = columns;
       board = g;
-      first = NULL;
+      segments = NULL;
+      numSegments = 0;
       finalized = false;
       modified = false;
+      trailStamp = -1;
+      changeLog.assign((stripelength + 63) / 64, 0);
+      keepingLog = false;
    }
    
    char cellAt(int position)
@@ -206,36 +501,116 @@ class NonogramRow: public NonogramStripe
       if(position < 0 || position >= stripelength)
          return ' ';
       else
-         return board->at(rowNumber, position);
+         return board->cell(rowNumber, position);
    }
-   void fill(int position)
+   bool fill(int position)
    {
-      if(board->at(rowNumber, position) != '#')
-         modified = true;
-      board->fill(rowNumber, position);
+      return fill(position, position + 1);
    }
-   void empty(int position)
+   bool empty(int position)
    {
-      if(board->at(rowNumber, position) != ' ')
+      return empty(position, position + 1);
+   }
+   
+   //A row's cells sit side by side in the grid's bit planes,
+   //so a range can be filled or emptied a whole word at a time.
+   bool fill(int start, int end)
+   {
+      if(start >= end)
+         return true;
+      if(start < 0 || end > stripelength)
+         throw "Out of bounds error!";
+      for(int w = start >> 6; w <= (end - 1) >> 6; w++)
+      {
+         uint64_t changed;
+         if(!board->fillBits(rowNumber, w, bitRange(max(start - w*64, 0), min(end - w*64, 64)), changed))
+            return false;
+         recordChanges(w, changed);
+      }
+      return true;
+   }
+   bool empty(int start, int end)
+   {
+      //squares outside the grid are already considered empty
+      if(start < 0)
+         start = 0;
+      if(end > stripelength)
+         end = stripelength;
+      if(start >= end)
+         return true;
+      for(int w = start >> 6; w <= (end - 1) >> 6; w++)
+      {
+         uint64_t changed;
+         if(!board->emptyBits(rowNumber, w, bitRange(max(start - w*64, 0), min(end - w*64, 64)), changed))
+            return false;
+         recordChanges(w, changed);
+      }
+      return true;
+   }
+   
+   //where this row's cells are in the grid's bit planes
+   const uint64_t* filledPlane()
+   {
+      return board->filledPlane();
+   }
+   const uint64_t* emptiedPlane()
+   {
+      return board->emptiedPlane();
+   }
+   size_t firstBit()
+   {
+      return board->bitIndex(rowNumber, 0);
+   }
+   size_t bitStride()
+   {
+      return 1;
+   }
+   
+   private:
+   void recordChanges(int word, uint64_t bits)
+   {
+      while(bits != 0)
+      {
          modified = true;
-      board->empty(rowNumber, position);
+         changes.push_back(word*64 + __builtin_ctzll(bits));
+         bits &= bits - 1;
+      }
    }
 };
 
-class NonogramColumn: public NonogramStripe
+class NonogramColumn final: public NonogramStripe
 {
    private:
    int colNumber;
+   int colWord; //which word of each row holds this column
+   uint64_t colBit; //and which bit of it
+   size_t first, stride; //where this column's cells are, in the mirror if there is one
    
    public:
    NonogramColumn(int rows, int column, GameGrid *g)
    {
       colNumber = column;
+      colWord = column >> 6;
+      colBit = (uint64_t)1 << (column & 63);
+      if(g->isMirrored())
+      {
+         first = g->columnBitIndex(0, column);
+         stride = 1;
+      }
+      else
+      {
+         first = g->bitIndex(0, column);
+         stride = (size_t)g->getRowWords() * 64;
+      }
       stripelength = rows;
       board = g;
-      first = NULL;
+      segments = NULL;
+      numSegments = 0;
       finalized = false;
       modified = false;
+      trailStamp = -1;
+      changeLog.assign((stripelength + 63) / 64, 0);
+      keepingLog = false;
    }
    
    char cellAt(int position)
@@ -243,33 +618,543 @@ class NonogramColumn: public NonogramStripe
       if(position <0 || position >= stripelength)
          return ' ';
       else
-         return board->at(position, colNumber);
+         return board->cell(position, colNumber);
+   }
+   bool fill(int position)
+   {
+      uint64_t changed;
+      if(position < 0 || position >= stripelength)
+         throw "Out of bounds error!";
+      if(!board->fillBits(position, colWord, colBit, changed))
+         return false;
+      if(changed != 0)
+      {
+         modified = true;
+         changes.push_back(position);
+      }
+      return true;
    }
-   void fill(int position)
+   bool empty(int position)
    {
-      if(board->at(position, colNumber) != '#')
+      uint64_t changed;
+      if(position < 0 || position >= stripelength)
+         return true; //squares outside the grid are already considered empty
+      if(!board->emptyBits(position, colWord, colBit, changed))
+         return false;
+      if(changed != 0)
+      {
          modified = true;
-      board->fill(position, colNumber);
+         changes.push_back(position);
+      }
+      return true;
+   }
+   //With the mirror, a column's cells sit side by side just
+   //like a row's, and a range can go a whole word at a time.
+   bool fill(int start, int end)
+   {
+      if(!board->isMirrored())
+      {
+         for(int i = start; i < end; i++)
+            if(!fill(i))
+               return false;
+         return true;
+      }
+      if(start >= end)
+         return true;
+      if(start < 0 || end > stripelength)
+         throw "Out of bounds error!";
+      for(int w = start >> 6; w <= (end - 1) >> 6; w++)
+      {
+         uint64_t changed;
+         if(!board->fillColumnBits(colNumber, w, bitRange(max(start - w*64, 0), min(end - w*64, 64)), changed))
+            return false;
+         recordChanges(w, changed);
+      }
+      return true;
+   }
+   bool empty(int start, int end)
+   {
+      if(!board->isMirrored())
+      {
+         for(int i = start; i < end; i++)
+            if(!empty(i))
+               return false;
+         return true;
+      }
+      if(start < 0)
+         start = 0;
+      if(end > stripelength)
+         end = stripelength;
+      if(start >= end)
+         return true;
+      for(int w = start >> 6; w <= (end - 1) >> 6; w++)
+      {
+         uint64_t changed;
+         if(!board->emptyColumnBits(colNumber, w, bitRange(max(start - w*64, 0), min(end - w*64, 64)), changed))
+            return false;
+         recordChanges(w, changed);
+      }
+      return true;
+   }
+   
+   //where this column's cells are in the grid's bit planes
+   const uint64_t* filledPlane()
+   {
+      return board->isMirrored() ? board->columnFilledPlane() : board->filledPlane();
+   }
+   const uint64_t* emptiedPlane()
+   {
+      return board->isMirrored() ? board->columnEmptiedPlane() : board->emptiedPlane();
+   }
+   size_t firstBit()
+   {
+      return first;
    }
-   void empty(int position)
+   size_t bitStride()
    {
-      if(board->at(position, colNumber) != ' ')
+      return stride;
+   }
+   
+   private:
+   void recordChanges(int word, uint64_t bits)
+   {
+      while(bits != 0)
+      {
          modified = true;
-      board->empty(position, colNumber);
+         changes.push_back(word*64 + __builtin_ctzll(bits));
+         bits &= bits - 1;
+      }
+   }
+};
+
+//A row or a column as the rules in NonogramLogic.h see it, for when
+//the caller knows which of the two it has. Cell "position" of the
+//stripe is bit number first + position * stride of the grid's bit
+//planes (or of its mirror, for a column), so reading a cell needs
+//no virtual call and no lookup through the grid; the stride of a
+//row is a constant 1. Anything
+//that decides a cell still goes through the stripe itself, which
+//keeps track of what changed.
+template<class Stripe>
+class StripeView
+{
+   private:
+   Stripe *stripe;
+   const uint64_t *filled, *emptied;
+   size_t first;
+   int length;
+   
+   public:
+   StripeView(Stripe *s)
+   {
+      stripe = s;
+      filled = s->filledPlane();
+      emptied = s->emptiedPlane();
+      first = s->firstBit();
+      length = s->getLength();
+   }
+   
+   char cellAt(int position)
+   {
+      if(position < 0 || position >= length)
+         return ' ';
+      size_t bit = first + (size_t)position * stripe->bitStride();
+      uint64_t mask = (uint64_t)1 << (bit & 63);
+      if(filled[bit >> 6] & mask)
+         return '#';
+      else if(emptied[bit >> 6] & mask)
+         return ' ';
+      else
+         return '-';
+   }
+   //Up to 64 cells from position on, as bits: in "dark" the ones that
+   //are filled, and in "light" the ones that are empty.
+   void cellWord(int position, uint64_t &dark, uint64_t &light)
+   {
+      int count = min(length - position, 64);
+      size_t stride = stripe->bitStride();
+      dark = light = 0;
+      if(stride == 1)
+      {
+         size_t bit = first + position;
+         int shift = bit & 63;
+         size_t word = bit >> 6;
+         dark = filled[word] >> shift;
+         light = emptied[word] >> shift;
+         if(shift > 0 && shift + count > 64)
+         {
+            dark |= filled[word + 1] << (64 - shift);
+            light |= emptied[word + 1] << (64 - shift);
+         }
+         if(count < 64)
+         {
+            dark &= ((uint64_t)1 << count) - 1;
+            light &= ((uint64_t)1 << count) - 1;
+         }
+      }
+      else
+      {
+         for(int b = 0; b < count; b++)
+         {
+            size_t bit = first + (size_t)(position + b) * stride;
+            dark |= (filled[bit >> 6] >> (bit & 63) & 1) << b;
+            light |= (emptied[bit >> 6] >> (bit & 63) & 1) << b;
+         }
+      }
+   }
+   bool fill(int position)
+   {
+      return stripe->fill(position);
+   }
+   bool fill(int start, int end)
+   {
+      return stripe->fill(start, end);
+   }
+   bool empty(int position)
+   {
+      return stripe->empty(position);
+   }
+   bool empty(int start, int end)
+   {
+      return stripe->empty(start, end);
+   }
+   
+   int getLength()
+   {
+      return length;
+   }
+   int getNumSegments()
+   {
+      return stripe->getNumSegments();
+   }
+   Segment* getSegment(int i)
+   {
+      return stripe->getSegment(i);
+   }
+   Segment* getFirstSegment()
+   {
+      return stripe->getFirstSegment();
+   }
+   Segment* getLastSegment()
+   {
+      return stripe->getLastSegment();
+   }
+   bool isFinal()
+   {
+      return stripe->isFinal();
+   }
+   size_t changeCount()
+   {
+      return stripe->changeCount();
+   }
+   bool logKept()
+   {
+      return stripe->logKept();
+   }
+   bool changedBetween(int from, int to)
+   {
+      return stripe->changedBetween(from, to);
+   }
+   void restartLog()
+   {
+      stripe->restartLog();
    }
 };
 
+//Up to 64 cells from position on, as bits: in "dark" the ones that
+//are filled, and in "light" the ones that are empty.
+template<class Line>
+void readCells(Line *row, int position, uint64_t &dark, uint64_t &light)
+{
+   dark = light = 0;
+   for(int b = 0; b < 64 && position + b < row->getLength(); b++)
+   {
+      char c = row->cellAt(position + b);
+      if(c == '#')
+         dark |= (uint64_t)1 << b;
+      else if(c == ' ')
+         light |= (uint64_t)1 << b;
+   }
+}
+
+//A view can read them straight out of the grid's bit planes.
+template<class Stripe>
+void readCells(StripeView<Stripe> *view, int position, uint64_t &dark, uint64_t &light)
+{
+   view->cellWord(position, dark, light);
+}
+
+//How check() goes about a stripe: the hand-written rules only,
+//the rules followed by the exact line solver for anything they
+//left undecided, or the exact line solver on its own.
+enum CheckMode { RULES_ONLY, RULES_THEN_LINE_SOLVER, LINE_SOLVER_ONLY };
+
+//The queue of stripes waiting to be checked.
+//A stripe is only queued once, no matter how many
+//of its cells change before it gets its turn.
+//Stripes come off in the order they went on, unless byPriority is
+//set; then the stripe pushed the most times since it went on comes
+//off first (the one that got to that many first, among equals). Each
+//push is a cell of the stripe decided since, usually by a crossing
+//stripe, so the stripe with the most new cells to go on gets checked
+//first. Stripes are kept in a list for each priority, so a push only
+//moves a stripe up one list, and a pop takes the front of the highest.
+//How loose a stripe's segments still are (maxpos - minpos) would be
+//the other thing to go by, but on the sample puzzles it only made
+//more checks, whether it was added in or only used to break ties.
+struct WorkQueue
+{
+   deque<int> pending;
+   vector<bool> queued;
+   bool byPriority;
+   //when byPriority is set: a list of the waiting stripes for each
+   //priority, linked through after and before, and the highest
+   //priority that may have any
+   vector<int> priority, after, before, first, last;
+   int waiting, top;
+   
+   WorkQueue()
+   {
+      byPriority = false;
+      waiting = 0;
+      top = 0;
+   }
+   
+   //empties the queue, for a board with this many stripes
+   void reset(int stripes)
+   {
+      pending.clear();
+      queued.assign(stripes, false);
+      priority.assign(stripes, 0);
+      after.assign(stripes, -1);
+      before.assign(stripes, -1);
+      first.assign(2, -1);
+      last.assign(2, -1);
+      waiting = 0;
+      top = 0;
+   }
+   
+   //takes a stripe out of the list for its priority
+   void unlink(int index)
+   {
+      int p = priority[index];
+      (before[index] >= 0 ? after[before[index]] : first[p]) = after[index];
+      (after[index] >= 0 ? before[after[index]] : last[p]) = before[index];
+   }
+   
+   //puts a stripe at the back of the list for its priority
+   void link(int index)
+   {
+      int p = priority[index];
+      if(p >= (int)first.size())
+      {
+         first.resize(p + 1, -1);
+         last.resize(p + 1, -1);
+      }
+      before[index] = last[p];
+      after[index] = -1;
+      (last[p] >= 0 ? after[last[p]] : first[p]) = index;
+      last[p] = index;
+      top = max(top, p);
+   }
+   
+   void push(int index)
+   {
+      if(!byPriority)
+      {
+         if(!queued[index])
+         {
+            queued[index] = true;
+            pending.push_back(index);
+         }
+         return;
+      }
+      if(!queued[index])
+      {
+         queued[index] = true;
+         priority[index] = 0;
+         waiting++;
+      }
+      else
+         unlink(index);
+      priority[index]++;
+      link(index);
+   }
+   
+   int pop()
+   {
+      int index;
+      if(!byPriority)
+      {
+         index = pending.front();
+         pending.pop_front();
+      }
+      else
+      {
+         while(first[top] < 0)
+            top--;
+         index = first[top];
+         unlink(index);
+         waiting--;
+      }
+      queued[index] = false;
+      return index;
+   }
+   
+   bool isEmpty()
+   {
+      return byPriority ? waiting == 0 : pending.empty();
+   }
+   
+   int size()
+   {
+      return byPriority ? waiting : pending.size();
+   }
+};
+
+//The undo log for guessing. Every cell decided after a mark
+//is logged by the grid, and every stripe checked after a mark
+//has its segments saved the first time, so going back to the
+//mark only touches what actually changed since then.
+class Trail
+{
+   private:
+   struct SavedSegment
+   {
+      Segment *segment;
+      int minpos, maxpos;
+      bool placed;
+   };
+   struct SavedStripe
+   {
+      NonogramStripe *stripe;
+      bool finalized;
+   };
+   struct Mark
+   {
+      size_t cells, segments, stripes;
+      int numUnsolved, stamp;
+   };
+   vector<GameGrid::Change> cells;
+   vector<SavedSegment> segments;
+   vector<SavedStripe> stripes;
+   vector<Mark> marks;
+   int nextStamp;
+   
+   public:
+   Trail()
+   {
+      nextStamp = 0;
+   }
+   
+   vector<GameGrid::Change>* cellLog()
+   {
+      return &cells;
+   }
+   
+   int depth()
+   {
+      return marks.size();
+   }
+   
+   //where the cell log stood at the last mark: what comes after
+   //that is what has changed since
+   size_t cellsAtMark()
+   {
+      return marks.empty() ? 0 : marks.back().cells;
+   }
+   
+   void mark(int numUnsolved)
+   {
+      Mark m = { cells.size(), segments.size(), stripes.size(), numUnsolved, nextStamp++ };
+      marks.push_back(m);
+   }
+   
+   //call before a stripe's segments are touched
+   void save(NonogramStripe *r)
+   {
+      if(marks.empty() || r->trailStamp == marks.back().stamp)
+         return;
+      r->trailStamp = marks.back().stamp;
+      SavedStripe st = { r, r->getFinalized() };
+      stripes.push_back(st);
+      for(int i = 0; i < r->getNumSegments(); i++)
+      {
+         Segment *s = r->getSegment(i);
+         SavedSegment seg = { s, s->minpos, s->maxpos, s->placed };
+         segments.push_back(seg);
+      }
+   }
+   
+   //goes back to the last mark; returns the number of
+   //unsolved stripes there was at the time
+   int undo(GameGrid *g)
+   {
+      Mark m = marks.back();
+      marks.pop_back();
+      while(cells.size() > m.cells)
+      {
+         g->undo(cells.back());
+         cells.pop_back();
+      }
+      while(segments.size() > m.segments)
+      {
+         SavedSegment &seg = segments.back();
+         seg.segment->minpos = seg.minpos;
+         seg.segment->maxpos = seg.maxpos;
+         seg.segment->placed = seg.placed;
+         segments.pop_back();
+      }
+      while(stripes.size() > m.stripes)
+      {
+         stripes.back().stripe->setFinalized(stripes.back().finalized);
+         stripes.pop_back();
+      }
+      return m.numUnsolved;
+   }
+};
+
+//Which of a board's budgets ran out, if one did: the time it was given,
+//or the number of checks or guesses.
+enum Budget { BUDGET_NONE, BUDGET_TIME, BUDGET_CHECKS, BUDGET_GUESSES };
+
+class ThreadPool; //see NonogramThreads.h
+class Logger; //see NonogramLog.h
+class LineCache; //see NonogramLineCache.h
+
 //This struct maintains the entire board,
 //keeping track of where each row is and
-//which has been last modified; this is necessary
-//for Step 10, the "emergency check."
+//which rows still need to be checked.
+//Rows come first in stripes, followed by the columns.
+//The rows, the columns and all of their segments are
+//each kept in one block, so a puzzle takes only a
+//handful of allocations no matter how big it is.
 
 struct RowManager
 {
-   int numOfRows, numOfCols, nextToCheck, lastModified, numUnsolved;
+   int numOfRows, numOfCols, numUnsolved;
    vector<NonogramStripe*> stripes;
+   vector<NonogramRow> rows;
+   vector<NonogramColumn> columns;
+   vector<Segment> segments;
    GameGrid *g;
+   CheckMode mode;
+   WorkQueue dirty;
+   int checkCount, checksSaved, guessCount;
+   bool probing; //when set, the search probes cells before it guesses (see NonogramProbe.h)
+   int probeCount, probedCells; //probes made, and cells they showed had to be one way
+   int steals; //tasks one thread of the parallel search took from another (see NonogramParallelSearch.h)
+   double searchTime, idleTime; //seconds the parallel search took, and that its threads spent waiting for work
+   Trail *trail; //set while guessing, otherwise NULL
+   Logger *log; //where progress is reported, if anywhere
+   ThreadPool *pool; //when set, rows and columns are checked in parallel phases
+   LineCache *cache; //when set, checks that have been made before are played back from it
+   bool hasDeadline; //when set, solving gives up at the deadline
+   chrono::steady_clock::time_point deadline;
+   int checkLimit, guessLimit; //when not 0, solving gives up once checkCount or guessCount gets there
+   atomic<int> *sharedChecks; //when set, checkLimit is what has been taken from here so far (see pastCheckLimit)
+   Budget exhausted; //the budget that made solving give up, if any
 };
 
 
-#endif
\ No newline at end of file
+#endif
\ No newline at end of file
@@ -0,0 +1,291 @@
+//Title: NonogramOutput.h
+//Description: Writes finished (or unfinished) grids out in one of
+//several formats, through a buffer, so that a batch of thousands of
+//puzzles can go to one stream a large block at a time:
+//   text  one character per cell, as printToFile writes it: '#' for
+//         a dark cell, ' ' for a light one, '-' for an undecided one
+//   bits  one bit per cell: "NGB1", then the number of rows, of columns
+//         and of bytes in the puzzle's name (each four bytes, lowest
+//         first), the name, and the rows, each padded out to a whole
+//         byte, first cell in the highest bit, 1 for dark. A grid with
+//         undecided cells starts "NGB2" instead and has a second set of
+//         rows after the first, with 1 for every cell that is decided.
+//   pbm   a binary PBM image (P4), or, for a grid with undecided cells,
+//         a PGM image (P5) with those cells in gray; many images can
+//         follow one another in one file
+//   rle   a line "rows columns", then each row as runs: a count and
+//         then '#', '.' or '-', with counts of 1 left out ("3#.2#")
+//When many pictures go into one stream, the text and rle pictures
+//start with a line "name rows columns status" instead, and the pbm
+//pictures have the name and status in a comment.
+
+#ifndef NONOGRAMOUTPUT_H
+#define NONOGRAMOUTPUT_H
+
+#include "NonogramObjects.h"
+#include <iostream>
+#include <string>
+#include <mutex>
+#include <stdint.h>
+
+using namespace std;
+
+enum PictureFormat { PICTURE_TEXT, PICTURE_BITS, PICTURE_PBM, PICTURE_RLE };
+
+inline const char *const pictureFormatNames[] = { "text", "bits", "pbm", "rle" };
+
+//for a file of its own
+inline const char *const pictureExtensions[] = { ".txt", ".bin", ".pbm", ".rle" };
+
+//Reads a format by name, for the command line; returns false for an unknown name.
+inline bool parsePictureFormat(const string &name, PictureFormat &format)
+{
+   for(int i = 0; i < 4; i++)
+      if(name == pictureFormatNames[i])
+      {
+         format = (PictureFormat)i;
+         return true;
+      }
+   return false;
+}
+
+//true if every cell has been decided
+inline bool gridIsComplete(GameGrid &g)
+{
+   const uint64_t *filled = g.filledPlane(), *emptied = g.emptiedPlane();
+   for(int i = 0; i < g.getRows(); i++)
+      for(int w = 0; w < g.getRowWords(); w++)
+      {
+         int word = i * g.getRowWords() + w;
+         uint64_t used = bitRange(0, min(g.getColumns() - w * 64, 64));
+         if((filled[word] | emptied[word]) != used)
+            return false;
+      }
+   return true;
+}
+
+//The word of row i's cells from column j on that are in the same state
+//as cell j: dark, light or undecided, one bit per cell from bit 0.
+inline uint64_t sameAs(GameGrid &g, int i, int j, char c)
+{
+   size_t word = (size_t)i * g.getRowWords() + (j >> 6);
+   uint64_t filled = g.filledPlane()[word] >> (j & 63), emptied = g.emptiedPlane()[word] >> (j & 63);
+   if(c == '#')
+      return filled;
+   else if(c == ' ')
+      return emptied;
+   else
+      return ~(filled | emptied);
+}
+
+//How many cells of row i from column j on are the same as cell j,
+//looked at up to 64 at a time.
+inline int runLength(GameGrid &g, int i, int j)
+{
+   char c = g.cell(i, j);
+   int start = j;
+   while(j < g.getColumns())
+   {
+      uint64_t same = sameAs(g, i, j, c);
+      int inWord = 64 - (j & 63);
+      int run = (~same == 0) ? 64 : __builtin_ctzll(~same);
+      j += min(run, inWord);
+      if(run < inWord)
+         break;
+   }
+   return min(j, g.getColumns()) - start;
+}
+
+//the order of a byte's bits turned around
+inline unsigned char reverseBits(unsigned char b)
+{
+   return (unsigned char)(((b * 0x0202020202ULL) & 0x010884422010ULL) % 1023);
+}
+
+//Appends the grid's rows from a bit plane, packed eight cells to a byte,
+//first cell in the highest bit. "other" is or'd in if given.
+inline void appendPackedRows(string &out, GameGrid &g, const uint64_t *plane, const uint64_t *other)
+{
+   int bytesPerRow = (g.getColumns() + 7) / 8;
+   for(int i = 0; i < g.getRows(); i++)
+   {
+      const uint64_t *row = plane + (size_t)i * g.getRowWords();
+      const uint64_t *otherRow = (other != NULL) ? other + (size_t)i * g.getRowWords() : NULL;
+      for(int b = 0; b < bytesPerRow; b++)
+      {
+         uint64_t word = row[b >> 3] | (otherRow != NULL ? otherRow[b >> 3] : 0);
+         unsigned char bits = (unsigned char)(word >> ((b & 7) * 8));
+         int cells = min(g.getColumns() - b * 8, 8);
+         if(cells < 8)
+            bits &= (1 << cells) - 1;
+         out += (char)reverseBits(bits);
+      }
+   }
+}
+
+inline void appendWord32(string &out, uint32_t value)
+{
+   for(int i = 0; i < 4; i++)
+      out += (char)((value >> (8 * i)) & 0xFF);
+}
+
+//Writes pictures to a stream, keeping them in a buffer until there is
+//a good amount to write. Any number of threads can write pictures to
+//the same PictureWriter; each picture goes out in one piece.
+class PictureWriter
+{
+   private:
+   ostream &out;
+   PictureFormat format;
+   bool named;
+   size_t bufferSize;
+   string buffer;
+   size_t total;
+   int count;
+   mutex lock;
+
+   //a run at a time, since most rows of a finished picture have long runs
+   void appendText(string &text, GameGrid &g)
+   {
+      text.reserve(text.size() + (size_t)g.getRows() * (g.getColumns() + 1));
+      for(int i = 0; i < g.getRows(); i++)
+      {
+         int j = 0;
+         while(j < g.getColumns())
+         {
+            int run = runLength(g, i, j);
+            text.append(run, g.cell(i, j));
+            j += run;
+         }
+         text += '\n';
+      }
+   }
+
+   void appendRuns(string &text, GameGrid &g)
+   {
+      for(int i = 0; i < g.getRows(); i++)
+      {
+         int j = 0;
+         while(j < g.getColumns())
+         {
+            char c = g.cell(i, j);
+            int run = runLength(g, i, j);
+            if(run > 1)
+               text += to_string(run);
+            text += (c == ' ') ? '.' : c;
+            j += run;
+         }
+         text += '\n';
+      }
+   }
+
+   void appendImage(string &text, GameGrid &g, bool complete, const string &comment)
+   {
+      text += complete ? "P4\n" : "P5\n";
+      if(!comment.empty())
+         text += "# " + comment + "\n";
+      text += to_string(g.getColumns()) + " " + to_string(g.getRows()) + "\n";
+      if(complete)
+         appendPackedRows(text, g, g.filledPlane(), NULL);
+      else
+      {
+         text += "255\n";
+         for(int i = 0; i < g.getRows(); i++)
+         {
+            int j = 0;
+            while(j < g.getColumns())
+            {
+               char c = g.cell(i, j);
+               int run = runLength(g, i, j);
+               text.append(run, (char)(c == '#' ? 0 : c == ' ' ? 255 : 128));
+               j += run;
+            }
+         }
+      }
+   }
+
+   void appendBits(string &text, GameGrid &g, bool complete, const string &name)
+   {
+      text += complete ? "NGB1" : "NGB2";
+      appendWord32(text, g.getRows());
+      appendWord32(text, g.getColumns());
+      appendWord32(text, name.size());
+      text += name;
+      appendPackedRows(text, g, g.filledPlane(), NULL);
+      if(!complete)
+         appendPackedRows(text, g, g.filledPlane(), g.emptiedPlane());
+   }
+
+   public:
+   //"many" puts each picture's name (and status) in front of it,
+   //for a stream that will hold more than one picture.
+   PictureWriter(ostream &o, PictureFormat f, bool many, size_t size = 1 << 20) : out(o)
+   {
+      format = f;
+      named = many;
+      bufferSize = size;
+      total = 0;
+      count = 0;
+   }
+
+   ~PictureWriter()
+   {
+      flush();
+   }
+
+   void write(GameGrid &g, const string &name = "", const string &status = "solved")
+   {
+      string text;
+      bool complete = gridIsComplete(g);
+      string header = name + " " + to_string(g.getRows()) + " " + to_string(g.getColumns()) + " " + status;
+      switch(format)
+      {
+         case PICTURE_TEXT:
+            if(named)
+               text += header + "\n";
+            appendText(text, g);
+            break;
+         case PICTURE_BITS:
+            appendBits(text, g, complete, named ? name : "");
+            break;
+         case PICTURE_PBM:
+            appendImage(text, g, complete, named ? name + " " + status : "");
+            break;
+         case PICTURE_RLE:
+            text += named ? header : to_string(g.getRows()) + " " + to_string(g.getColumns());
+            text += "\n";
+            appendRuns(text, g);
+            break;
+      }
+      lock_guard<mutex> guard(lock);
+      buffer += text;
+      total += text.size();
+      count++;
+      if(buffer.size() >= bufferSize)
+      {
+         out.write(buffer.data(), buffer.size());
+         buffer.clear();
+      }
+   }
+
+   void flush()
+   {
+      lock_guard<mutex> guard(lock);
+      out.write(buffer.data(), buffer.size());
+      out.flush();
+      buffer.clear();
+   }
+
+   //bytes and pictures written so far
+   size_t bytesWritten()
+   {
+      return total;
+   }
+
+   int picturesWritten()
+   {
+      return count;
+   }
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,344 @@
+//Title: NonogramParallelSearch.h
+//Description: The search again, for a board with a thread pool, with
+//every thread of the pool guessing at once. Each thread has a board of
+//its own (made with copyBoard, see NonogramProbe.h) and a trail to go
+//back on, and searches a subtree depth first, the way searchFrom does.
+//A subtree is handed around as a task: the board as it stood at a
+//guess, and the guess to make there. Each thread keeps its tasks on a
+//deque of its own. Whenever its deque runs low, a thread leaves the
+//second way of the cell it is guessing at to a task at the back of it,
+//rather than trying that way itself. It takes its next task from the
+//back again, once it is done with the one it has, so on its own it
+//goes through the tree in the same order searchFrom would; a thread
+//with nothing to do steals from the front of another thread's deque,
+//where the tasks nearest the root (the biggest ones) are.
+//The first thread to find a solution stops all the others, and the
+//solution is copied onto the board. With more than one solution, which
+//one that is can change from run to run. The board's limits on guesses
+//and on checks are shared by all the threads, so they mean the same as
+//they do without the pool; the first thread to find one used up stops
+//the search, as the deadline does.
+
+#ifndef NONOGRAMPARALLELSEARCH_H
+#define NONOGRAMPARALLELSEARCH_H
+
+#include "NonogramSearch.h"
+#include "NonogramProbe.h"
+#include "NonogramObjects.h"
+#include "NonogramScheduler.h"
+#include "NonogramThreads.h"
+#include "NonogramLog.h"
+#include <vector>
+#include <deque>
+#include <string>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <chrono>
+
+using namespace std;
+
+//a thread leaves the second way of a guess to a task while it has fewer than this many
+const int shareBelow = 2;
+
+//A subtree of the search: a board at some point, and a cell to guess
+//there (none for the whole tree).
+struct SearchTask : BoardState
+{
+   int row, column;
+   bool fill;
+
+   SearchTask(RowManager &b, int r, int c, bool f) : BoardState(b)
+   {
+      row = r;
+      column = c;
+      fill = f;
+   }
+};
+
+class ParallelSearch
+{
+   private:
+   //what each thread has of its own
+   struct Worker
+   {
+      RowManager board;
+      Trail trail;
+      Prober *prober;
+      deque<SearchTask*> tasks;
+      mutex lock;
+      int steals;
+      double idle; //seconds
+   };
+
+   RowManager &m;
+   vector<Worker*> workers;
+   atomic<int> pending; //tasks made that haven't been finished yet
+   atomic<bool> stopping;
+   atomic<int> guessesLeft; //if the board has a limit on guesses
+   atomic<int> checksLeft; //if it has one on checks
+   mutex answerLock;
+   bool solved, timedOut;
+
+   void push(Worker &w, SearchTask *task)
+   {
+      pending++;
+      lock_guard<mutex> guard(w.lock);
+      w.tasks.push_back(task);
+   }
+
+   bool runningLow(Worker &w)
+   {
+      lock_guard<mutex> guard(w.lock);
+      return (int)w.tasks.size() < shareBelow;
+   }
+
+   //The thread's own newest task, or failing that, the oldest task of
+   //another thread; NULL if there are none anywhere just now.
+   SearchTask* take(int t)
+   {
+      Worker &w = *workers[t];
+      {
+         lock_guard<mutex> guard(w.lock);
+         if(!w.tasks.empty())
+         {
+            SearchTask *task = w.tasks.back();
+            w.tasks.pop_back();
+            return task;
+         }
+      }
+      int count = workers.size();
+      for(int k = 1; k < count; k++)
+      {
+         Worker &victim = *workers[(t + k) % count];
+         lock_guard<mutex> guard(victim.lock);
+         if(!victim.tasks.empty())
+         {
+            SearchTask *task = victim.tasks.front();
+            victim.tasks.pop_front();
+            w.steals++;
+            return task;
+         }
+      }
+      return NULL;
+   }
+
+   //false if the board's guesses have run out
+   bool takeGuess(Worker &w)
+   {
+      if(m.guessLimit > 0 && guessesLeft-- <= 0)
+      {
+         w.board.exhausted = BUDGET_GUESSES;
+         return false;
+      }
+      w.board.guessCount++;
+      return true;
+   }
+
+   //searchFrom, but stopping as soon as any thread is done, and
+   //leaving the second way of a guess to a task if the deque is low
+   SearchResult searchTree(Worker &w)
+   {
+      RowManager &b = w.board;
+      if(stopping)
+         return SEARCH_OUT_OF_TIME;
+      PropagateResult propagated = propagateStripes(b);
+      if(propagated == PROPAGATE_STALLED && w.prober != NULL)
+         propagated = w.prober->run();
+      if(propagated != PROPAGATE_STALLED)
+         return fromPropagation(propagated);
+      int row, column;
+      if(!chooseCell(b, row, column))
+         return fullBoardIsValid(b) ? SEARCH_SOLVED : SEARCH_CONTRADICTION;
+      int ways = 2;
+      if(runningLow(w))
+      {
+         push(w, new SearchTask(b, row, column, false));
+         ways = 1;
+      }
+      for(int guess = 0; guess < ways; guess++)
+      {
+         if(!takeGuess(w))
+            return SEARCH_OUT_OF_TIME;
+         b.trail->mark(b.numUnsolved);
+         SearchResult result = SEARCH_CONTRADICTION;
+         if(guess == 0 ? b.stripes[row]->fill(column) : b.stripes[row]->empty(column))
+         {
+            b.dirty.push(row);
+            collectChanges(b, row);
+            result = searchTree(w);
+         }
+         if(result == SEARCH_SOLVED)
+            return SEARCH_SOLVED;
+         b.numUnsolved = b.trail->undo(b.g);
+         clearPendingWork(b);
+         if(result == SEARCH_OUT_OF_TIME)
+            return SEARCH_OUT_OF_TIME;
+      }
+      return SEARCH_CONTRADICTION;
+   }
+
+   void runTask(Worker &w, SearchTask *task)
+   {
+      RowManager &b = w.board;
+      task->restore(b);
+      b.trail->mark(b.numUnsolved);
+      SearchResult result = SEARCH_CONTRADICTION;
+      if(task->row < 0)
+         result = searchTree(w);
+      else if(!takeGuess(w))
+         result = SEARCH_OUT_OF_TIME;
+      else
+      {
+         if(task->fill ? b.stripes[task->row]->fill(task->column) : b.stripes[task->row]->empty(task->column))
+         {
+            b.dirty.push(task->row);
+            collectChanges(b, task->row);
+            result = searchTree(w);
+         }
+      }
+      if(result == SEARCH_SOLVED)
+      {
+         lock_guard<mutex> guard(answerLock);
+         if(!solved)
+         {
+            solved = true;
+            stopping = true;
+            BoardState(b).restore(m);
+         }
+      }
+      else if(result == SEARCH_OUT_OF_TIME && !stopping)
+      {
+         //nothing else stops a thread, so one of its budgets ran out
+         lock_guard<mutex> guard(answerLock);
+         if(!timedOut)
+            m.exhausted = b.exhausted;
+         timedOut = true;
+         stopping = true;
+      }
+      b.numUnsolved = b.trail->undo(b.g);
+      clearPendingWork(b);
+   }
+
+   void work(int t)
+   {
+      Worker &w = *workers[t];
+      chrono::steady_clock::time_point idleFrom = chrono::steady_clock::now();
+      int misses = 0;
+      while(!stopping && pending > 0)
+      {
+         SearchTask *task = take(t);
+         if(task == NULL)
+         {
+            //every task is being worked on; one of them may yet leave some behind
+            if(++misses < 64)
+               this_thread::yield();
+            else
+               this_thread::sleep_for(chrono::microseconds(50));
+            continue;
+         }
+         misses = 0;
+         chrono::steady_clock::time_point now = chrono::steady_clock::now();
+         w.idle += chrono::duration<double>(now - idleFrom).count();
+         runTask(w, task);
+         delete task;
+         pending--;
+         idleFrom = chrono::steady_clock::now();
+      }
+      w.idle += chrono::duration<double>(chrono::steady_clock::now() - idleFrom).count();
+   }
+
+   public:
+   ParallelSearch(RowManager &board) : m(board), pending(0), stopping(false)
+   {
+      guessesLeft = m.guessLimit - m.guessCount;
+      checksLeft = m.checkLimit - m.checkCount;
+      solved = false;
+      timedOut = false;
+      int threads = m.pool->size();
+      for(int t = 0; t < threads; t++)
+      {
+         Worker *w = new Worker();
+         copyBoard(m, w->board);
+         w->board.checkLimit = 0;
+         w->board.sharedChecks = (m.checkLimit > 0) ? &checksLeft : NULL;
+         w->board.trail = &w->trail;
+         w->board.g->trail = w->trail.cellLog();
+         w->board.probing = m.probing;
+         w->prober = m.probing ? new Prober(w->board) : NULL;
+         w->steals = 0;
+         w->idle = 0;
+         workers.push_back(w);
+      }
+   }
+
+   ~ParallelSearch()
+   {
+      for(size_t t = 0; t < workers.size(); t++)
+      {
+         Worker *w = workers[t];
+         for(size_t k = 0; k < w->tasks.size(); k++)
+            delete w->tasks[k];
+         delete w->prober;
+         w->board.g->trail = NULL;
+         w->board.trail = NULL;
+         freePuzzle(w->board);
+         delete w;
+      }
+   }
+
+   ParallelSearch(const ParallelSearch&) = delete;
+   ParallelSearch& operator=(const ParallelSearch&) = delete;
+
+   //Searches from the board as it stands, with every thread of the pool,
+   //and adds what the threads did to the board's counts.
+   SearchResult run()
+   {
+      chrono::steady_clock::time_point start = chrono::steady_clock::now();
+      push(*workers[0], new SearchTask(m, -1, -1, true));
+      m.pool->run(workers.size(), [this](int t) { work(t); });
+      m.searchTime = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+      for(size_t t = 0; t < workers.size(); t++)
+      {
+         RowManager &b = workers[t]->board;
+         m.checkCount += b.checkCount;
+         m.checksSaved += b.checksSaved;
+         m.guessCount += b.guessCount;
+         m.probeCount += b.probeCount;
+         m.probedCells += b.probedCells;
+         m.steals += workers[t]->steals;
+         m.idleTime += workers[t]->idle;
+      }
+      if(m.log != NULL && m.log->shows(LOG_PASSES))
+         m.log->write(LOG_PASSES, "Parallel search: " + to_string(m.guessCount) + " guesses on "
+                         + to_string(workers.size()) + " threads in " + to_string(m.searchTime * 1e3) + " ms ("
+                         + to_string((int)(m.guessCount / max(m.searchTime, 1e-9))) + " a second), "
+                         + to_string(m.steals) + " steals, " + to_string(m.idleTime * 1e3) + " ms idle");
+      return solved ? SEARCH_SOLVED : timedOut ? SEARCH_OUT_OF_TIME : SEARCH_CONTRADICTION;
+   }
+};
+
+//searchBoard, with the guessing spread across the board's thread pool
+//if it has one. Probing at the top of the tree is done on the board
+//itself, a batch at a time across the pool, before the threads split up.
+inline SearchResult searchBoardParallel(RowManager &m)
+{
+   if(m.pool == NULL)
+      return searchBoard(m);
+   PropagateResult propagated = propagateStripes(m);
+   if(propagated == PROPAGATE_STALLED && m.probing)
+   {
+      Trail trail;
+      m.trail = &trail;
+      m.g->trail = trail.cellLog();
+      propagated = Prober(m).run();
+      m.g->trail = NULL;
+      m.trail = NULL;
+   }
+   if(propagated != PROPAGATE_STALLED)
+      return fromPropagation(propagated);
+   ParallelSearch search(m);
+   return search.run();
+}
+
+#endif
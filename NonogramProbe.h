@@ -0,0 +1,342 @@
+//Title: NonogramProbe.h
+//Description: Probing, a stage between propagation and guessing.
+//When propagation stalls, undecided cells are tried both ways in
+//turn: filled, propagated and taken back, then emptied the same way.
+//If one way leads to a contradiction, the cell has to be the other
+//way, and it goes on the board for good (or for as long as the guess
+//it was found under lasts). If both ways do, the board is wrong.
+//Only what is forced is kept, so probing never loses a solution; it
+//just leaves the search fewer cells to guess at.
+//Probes are taken back with the trail, the same as guesses, rather
+//than by copying the board. Cells are probed in batches, each probe
+//in a batch starting from the same board, and what a batch finds is
+//put on the board afterwards. With a thread pool, a batch is split
+//across the threads, each probing on a copy of the board of its own,
+//made once and brought up to date at the start of every batch; the
+//batches are the same whatever the number of threads, and so is the
+//outcome.
+//Cells in the rows and columns that changed last are probed first,
+//since that is where a probe is most likely to find something new.
+
+#ifndef NONOGRAMPROBE_H
+#define NONOGRAMPROBE_H
+
+#include "NonogramObjects.h"
+#include "NonogramScheduler.h"
+#include "NonogramLoader.h"
+#include "NonogramThreads.h"
+#include "NonogramLog.h"
+#include <vector>
+#include <deque>
+#include <string>
+#include <atomic>
+
+using namespace std;
+
+//how many cells are probed from the same board before what was found goes on it
+const int probeBatch = 16;
+
+//Tries the cell one way, propagates, and takes it all back again.
+//The board needs a trail.
+inline PropagateResult probeCell(RowManager &m, int row, int column, bool fill)
+{
+   m.trail->mark(m.numUnsolved);
+   m.probeCount++;
+   PropagateResult result = PROPAGATE_CONTRADICTION;
+   if(fill ? m.stripes[row]->fill(column) : m.stripes[row]->empty(column))
+   {
+      m.dirty.push(row);
+      collectChanges(m, row);
+      result = propagateStripes(m);
+   }
+   m.numUnsolved = m.trail->undo(m.g);
+   clearPendingWork(m);
+   return result;
+}
+
+//What probing a cell both ways showed: '#' or ' ' if it has to be
+//that, 'x' if it can be neither, 't' if time ran out, and '-' if
+//it could still be either.
+inline char probeBothWays(RowManager &m, int row, int column)
+{
+   PropagateResult filled = probeCell(m, row, column, true);
+   if(filled == PROPAGATE_OUT_OF_TIME)
+      return 't';
+   PropagateResult emptied = probeCell(m, row, column, false);
+   if(emptied == PROPAGATE_OUT_OF_TIME)
+      return 't';
+   if(filled == PROPAGATE_CONTRADICTION)
+      return emptied == PROPAGATE_CONTRADICTION ? 'x' : ' ';
+   return emptied == PROPAGATE_CONTRADICTION ? '#' : '-';
+}
+
+//A second board with the same clues, for a thread to probe on.
+//Its cells and segments are filled in by syncBoard.
+inline void copyBoard(RowManager &from, RowManager &to)
+{
+   PuzzleClues clues;
+   clues.rows = from.numOfRows;
+   clues.cols = from.numOfCols;
+   clues.line = 0;
+   for(size_t i = 0; i < from.stripes.size(); i++)
+   {
+      NonogramStripe *r = from.stripes[i];
+      clues.counts.push_back(r->getNumSegments());
+      for(int j = 0; j < r->getNumSegments(); j++)
+         clues.lengths.push_back(r->getSegment(j)->length);
+   }
+   buildPuzzle(clues, to, from.g->isMirrored());
+   to.mode = from.mode;
+   to.cache = from.cache;
+   to.hasDeadline = from.hasDeadline;
+   to.deadline = from.deadline;
+   to.checkLimit = from.checkLimit;
+   to.guessLimit = from.guessLimit;
+   to.dirty.byPriority = from.dirty.byPriority;
+   initSchedule(to);
+}
+
+//Puts a copy made by copyBoard in the same state as the board, with
+//nothing waiting to be checked, its counts back at zero and none of
+//its budgets used up.
+inline void syncBoard(RowManager &from, RowManager &to)
+{
+   to.g->copyCells(*from.g);
+   for(size_t k = 0; k < from.segments.size(); k++)
+      to.segments[k] = from.segments[k];
+   for(size_t i = 0; i < from.stripes.size(); i++)
+      to.stripes[i]->setFinalized(from.stripes[i]->getFinalized());
+   clearPendingWork(to);
+   to.numUnsolved = from.numUnsolved;
+   to.checkCount = 0;
+   to.probeCount = 0;
+   to.exhausted = BUDGET_NONE;
+}
+
+class Prober
+{
+   private:
+   RowManager &m;
+   //Cells waiting to be probed, as row * columns + column. A cell can be
+   //in there more than once; only the copy that went in last counts.
+   deque<pair<int, int> > queue;
+   vector<int> latest;
+   int stamp;
+   //a board and a trail for each thread of the pool, if there is one
+   vector<RowManager*> copies;
+   vector<Trail*> copyTrails;
+   Budget copiesExhausted; //the budget a copy ran out of in the last batch, if any
+
+   void push(int cell, bool front)
+   {
+      latest[cell] = ++stamp;
+      if(front)
+         queue.push_front(make_pair(cell, stamp));
+      else
+         queue.push_back(make_pair(cell, stamp));
+   }
+
+   //The next cell still worth probing, or -1 if there are none.
+   int pop()
+   {
+      while(!queue.empty())
+      {
+         pair<int, int> next = queue.front();
+         queue.pop_front();
+         if(latest[next.first] != next.second)
+            continue;
+         latest[next.first] = 0;
+         if(m.g->cell(next.first / m.numOfCols, next.first % m.numOfCols) == '-')
+            return next.first;
+      }
+      return -1;
+   }
+
+   //Puts the undecided cells of every row and column that has a cell
+   //in the trail's cell log from "from" on at the front of the queue,
+   //those that changed last first.
+   void queueAround(size_t from)
+   {
+      vector<GameGrid::Change> &log = *m.trail->cellLog();
+      vector<bool> seen(m.stripes.size(), false);
+      vector<int> touched;
+      int rowWords = m.g->getRowWords();
+      for(size_t c = log.size(); c > from; c--)
+      {
+         int row = log[c - 1].word / rowWords;
+         int base = (log[c - 1].word % rowWords) * 64;
+         if(!seen[row])
+         {
+            seen[row] = true;
+            touched.push_back(row);
+         }
+         for(uint64_t bits = log[c - 1].bits; bits != 0; bits &= bits - 1)
+         {
+            int column = m.numOfRows + base + __builtin_ctzll(bits);
+            if(!seen[column])
+            {
+               seen[column] = true;
+               touched.push_back(column);
+            }
+         }
+      }
+      for(size_t t = touched.size(); t > 0; t--)
+      {
+         int index = touched[t - 1];
+         NonogramStripe *r = m.stripes[index];
+         for(int p = r->getLength() - 1; p >= 0; p--)
+            if(r->cellAt(p) == '-')
+               push(index < m.numOfRows ? index * m.numOfCols + p : p * m.numOfCols + index - m.numOfRows, true);
+      }
+   }
+
+   //Every undecided cell goes in, those near what the last guess changed
+   //first, and then the rest with the most constrained crossings first.
+   void fillQueue()
+   {
+      queue.clear();
+      latest.assign(m.numOfRows * m.numOfCols, 0);
+      stamp = 0;
+      vector<int> openInRow(m.numOfRows, 0), openInColumn(m.numOfCols, 0);
+      vector<pair<int, int> > rest;
+      for(int i = 0; i < m.numOfRows; i++)
+         for(int j = 0; j < m.numOfCols; j++)
+            if(m.g->cell(i, j) == '-')
+            {
+               openInRow[i]++;
+               openInColumn[j]++;
+            }
+      for(int i = 0; i < m.numOfRows; i++)
+         for(int j = 0; openInRow[i] > 0 && j < m.numOfCols; j++)
+            if(m.g->cell(i, j) == '-')
+               rest.push_back(make_pair(openInRow[i] + openInColumn[j], i * m.numOfCols + j));
+      stable_sort(rest.begin(), rest.end(),
+                  [](const pair<int, int> &a, const pair<int, int> &b) { return a.first < b.first; });
+      for(size_t c = 0; c < rest.size(); c++)
+         push(rest[c].second, false);
+      queueAround(m.trail->cellsAtMark());
+   }
+
+   //Probes every cell of the batch, on the board itself, or across the
+   //pool on the copies, and gives back what each one showed.
+   vector<char> probeBatchOf(const vector<int> &batch)
+   {
+      vector<char> found(batch.size(), '-');
+      if(m.pool == NULL)
+      {
+         for(size_t b = 0; b < batch.size(); b++)
+         {
+            found[b] = probeBothWays(m, batch[b] / m.numOfCols, batch[b] % m.numOfCols);
+            if(found[b] == 'x' || found[b] == 't')
+               break;
+         }
+         return found;
+      }
+      int threads = min((int)batch.size(), m.pool->size());
+      while((int)copies.size() < threads)
+      {
+         copies.push_back(new RowManager());
+         copyBoard(m, *copies.back());
+         copyTrails.push_back(new Trail());
+         copies.back()->trail = copyTrails.back();
+         copies.back()->g->trail = copyTrails.back()->cellLog();
+      }
+      //the copies share what is left of the board's checks
+      atomic<int> next(0), checksLeft(m.checkLimit - m.checkCount);
+      m.pool->run(threads, [&](int t)
+      {
+         RowManager &copy = *copies[t];
+         syncBoard(m, copy);
+         copy.checkLimit = 0;
+         copy.sharedChecks = (m.checkLimit > 0) ? &checksLeft : NULL;
+         for(int b = next++; b < (int)batch.size(); b = next++)
+            found[b] = probeBothWays(copy, batch[b] / m.numOfCols, batch[b] % m.numOfCols);
+      });
+      copiesExhausted = BUDGET_NONE;
+      for(int t = 0; t < threads; t++)
+      {
+         m.checkCount += copies[t]->checkCount;
+         m.probeCount += copies[t]->probeCount;
+         if(copiesExhausted == BUDGET_NONE)
+            copiesExhausted = copies[t]->exhausted;
+      }
+      return found;
+   }
+
+   public:
+   Prober(RowManager &board) : m(board)
+   {
+      stamp = 0;
+      copiesExhausted = BUDGET_NONE;
+   }
+
+   ~Prober()
+   {
+      for(size_t t = 0; t < copies.size(); t++)
+      {
+         freePuzzle(*copies[t]);
+         delete copies[t];
+         delete copyTrails[t];
+      }
+   }
+
+   Prober(const Prober&) = delete;
+   Prober& operator=(const Prober&) = delete;
+
+   //Probes until no cell that's left shows anything, putting what is
+   //found on the board and propagating it. Returns PROPAGATE_STALLED
+   //if the search still has guessing to do.
+   PropagateResult run()
+   {
+      fillQueue();
+      int probesBefore = m.probeCount, cellsBefore = m.probedCells;
+      PropagateResult result = PROPAGATE_STALLED;
+      while(result == PROPAGATE_STALLED)
+      {
+         vector<int> batch;
+         for(int cell = pop(); cell >= 0; cell = ((int)batch.size() < probeBatch) ? pop() : -1)
+            batch.push_back(cell);
+         if(batch.empty())
+            break;
+         vector<char> found = probeBatchOf(batch);
+         size_t logBefore = m.trail->cellLog()->size();
+         bool forced = false;
+         for(size_t b = 0; b < batch.size() && result == PROPAGATE_STALLED; b++)
+         {
+            int row = batch[b] / m.numOfCols, column = batch[b] % m.numOfCols;
+            if(found[b] == 'x')
+               result = PROPAGATE_CONTRADICTION;
+            else if(found[b] == 't')
+            {
+               //probing on the board itself has already said which budget ran out
+               result = PROPAGATE_OUT_OF_TIME;
+               if(m.exhausted == BUDGET_NONE)
+                  m.exhausted = copiesExhausted;
+            }
+            else if(found[b] != '-')
+            {
+               //every probe in the batch started from the same board,
+               //so each of these is forced on its own, and all of them at once
+               if(!(found[b] == '#' ? m.stripes[row]->fill(column) : m.stripes[row]->empty(column)))
+                  result = PROPAGATE_CONTRADICTION;
+               m.dirty.push(row);
+               collectChanges(m, row);
+               m.probedCells++;
+               forced = true;
+            }
+         }
+         if(result == PROPAGATE_STALLED && forced)
+         {
+            result = propagateStripes(m);
+            queueAround(logBefore);
+         }
+      }
+      if(m.log != NULL && m.log->shows(LOG_PASSES))
+         m.log->progress(LOG_PASSES, "Probing: " + to_string(m.probeCount - probesBefore) + " probes, "
+                         + to_string(m.probedCells - cellsBefore) + " cells forced, "
+                         + to_string(m.numUnsolved) + " stripes still unsolved");
+      return result;
+   }
+};
+
+#endif
@@ -0,0 +1,109 @@
+//Title: NonogramRuleStats.h
+//Description: Counts, for each step check() takes, how many times
+//it ran, how many cells it decided, and how long it took, so that
+//the steps that don't pay their way can be found. The counters are
+//only there when compiled with -DNONOGRAM_RULE_STATS; otherwise
+//RUN_RULE is nothing but the call itself. Either way, it gives back
+//whatever the step returned.
+
+#ifndef NONOGRAMRULESTATS_H
+#define NONOGRAMRULESTATS_H
+
+#include <iostream>
+#include <stdint.h>
+
+using namespace std;
+
+enum Rule { RULE_ORDER, RULE_EXISTING_FILLS, RULE_VALIDATE, RULE_FILL_KNOWN,
+            RULE_EMPTY_KNOWN, RULE_MIN_LENGTH, RULE_STEP8, RULE_LINE_SOLVER, NUM_RULES };
+
+inline const char *const ruleNames[] = { "putSegmentsInOrder", "accountForExistingFills", "validateSegmentPositions",
+                            "fillKnownSquares", "emptyKnownSquares", "minimumLengthCheck", "step8", "solveLine" };
+
+#ifdef NONOGRAM_RULE_STATS
+
+#include <atomic>
+#include <type_traits>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <chrono>
+#endif
+
+//Stripes are checked on several threads at once in parallel mode,
+//so the counters are shared and atomic.
+struct RuleCounters
+{
+   atomic<uint64_t> calls, cells, ticks;
+};
+
+inline RuleCounters ruleStats[NUM_RULES];
+
+//CPU cycles where there is a cycle counter, nanoseconds elsewhere
+inline uint64_t ruleClock()
+{
+#if defined(__x86_64__) || defined(__i386__)
+   return __rdtsc();
+#else
+   return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+//Counts one run of a rule on a stripe, even one that ends in a contradiction.
+template<class Line>
+struct RuleTimer
+{
+   Rule rule;
+   Line *row;
+   size_t cellsBefore;
+   uint64_t start;
+
+   RuleTimer(Rule r, Line *l)
+   {
+      rule = r;
+      row = l;
+      cellsBefore = row->changeCount();
+      start = ruleClock();
+   }
+
+   ~RuleTimer()
+   {
+      ruleStats[rule].ticks += ruleClock() - start;
+      ruleStats[rule].calls++;
+      ruleStats[rule].cells += row->changeCount() - cellsBefore;
+   }
+};
+
+#define RUN_RULE(rule, row, call) \
+   ([&]{ RuleTimer<typename remove_pointer<decltype(row)>::type> ruleTimer(rule, row); return call; }())
+
+inline void resetRuleStats()
+{
+   for(int i = 0; i < NUM_RULES; i++)
+      ruleStats[i].calls = ruleStats[i].cells = ruleStats[i].ticks = 0;
+}
+
+//Writes the counters out as JSON.
+inline void dumpRuleStats(ostream &out)
+{
+#if defined(__x86_64__) || defined(__i386__)
+   out << "{\n  \"ticks\": \"cycles\",\n  \"rules\": [\n";
+#else
+   out << "{\n  \"ticks\": \"nanoseconds\",\n  \"rules\": [\n";
+#endif
+   for(int i = 0; i < NUM_RULES; i++)
+   {
+      out << "    { \"rule\": \"" << ruleNames[i] << "\", \"calls\": " << ruleStats[i].calls
+          << ", \"cells\": " << ruleStats[i].cells << ", \"ticks\": " << ruleStats[i].ticks << " }"
+          << (i + 1 < NUM_RULES ? "," : "") << "\n";
+   }
+   out << "  ]\n}" << endl;
+}
+
+#else
+
+#define RUN_RULE(rule, row, call) (call)
+
+#endif
+
+#endif
\ No newline at end of file
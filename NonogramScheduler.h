@@ -0,0 +1,335 @@
+//Title: NonogramScheduler.h
+//Description: Decides which stripe gets checked next.
+//A stripe only needs another look when one of its cells
+//has been decided by a crossing stripe (or by itself),
+//so each change puts the crossing stripe on a work queue
+//and the solver stops once the queue runs dry.
+
+#ifndef NONOGRAMSCHEDULER_H
+#define NONOGRAMSCHEDULER_H
+
+#include "NonogramLogic.h"
+#include "NonogramObjects.h"
+#include "NonogramThreads.h"
+#include "NonogramLog.h"
+#include "NonogramLineCache.h"
+#include <iostream>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <atomic>
+
+using namespace std;
+
+//What came of checking stripes until there was nothing left to do.
+//PROPAGATE_OUT_OF_TIME is for any of the board's budgets running out,
+//not just its time; RowManager::exhausted says which.
+enum PropagateResult { PROPAGATE_SOLVED, PROPAGATE_STALLED, PROPAGATE_CONTRADICTION, PROPAGATE_OUT_OF_TIME };
+
+//true if the board has a deadline and it has gone by
+inline bool pastDeadline(RowManager &m)
+{
+   if(!m.hasDeadline || chrono::steady_clock::now() <= m.deadline)
+      return false;
+   m.exhausted = BUDGET_TIME;
+   return true;
+}
+
+//how many checks a board sharing its budget takes at a time
+const int sharedCheckChunk = 16;
+
+//true if the board has a limit on checks and has made that many;
+//only an int compare, so it can be asked before every check.
+//Boards that share one budget between threads (see ParallelSearch
+//and Prober) take more from it a few checks at a time, and only run
+//out once it is all gone.
+inline bool pastCheckLimit(RowManager &m)
+{
+   if(m.checkCount < m.checkLimit || (m.checkLimit <= 0 && m.sharedChecks == NULL))
+      return false;
+   if(m.sharedChecks != NULL)
+   {
+      int left = m.sharedChecks->fetch_sub(sharedCheckChunk);
+      if(left > 0)
+      {
+         m.checkLimit = m.checkCount + min(left, sharedCheckChunk);
+         return false;
+      }
+   }
+   m.exhausted = BUDGET_CHECKS;
+   return true;
+}
+
+//the same for guesses, asked before every guess
+inline bool pastGuessLimit(RowManager &m)
+{
+   if(m.guessLimit <= 0 || m.guessCount < m.guessLimit)
+      return false;
+   m.exhausted = BUDGET_GUESSES;
+   return true;
+}
+
+//Index (in RowManager::stripes) of the stripe crossing
+//stripe number "index" at the given position.
+inline int crossingStripe(RowManager &m, int index, int position)
+{
+   if(index < m.numOfRows)
+      return m.numOfRows + position;
+   else
+      return position;
+}
+
+//"row 3" or "column 7", for the log; both count from 0
+inline string stripeName(RowManager &m, int index)
+{
+   if(index < m.numOfRows)
+      return "row " + to_string(index);
+   else
+      return "column " + to_string(index - m.numOfRows);
+}
+
+//Checks one stripe, through the line cache if the board has one.
+inline bool checkStripe(RowManager &m, NonogramStripe *r)
+{
+   if(m.cache != NULL)
+      return checkStripeCached(*m.cache, r, m.mode);
+   else
+      return checkStripe(r, m.mode);
+}
+
+//Queue the crossing stripe of every cell this stripe
+//has decided since the last time we looked, and note
+//the cell in both stripes' change logs.
+inline void collectChanges(RowManager &m, int index)
+{
+   NonogramStripe *r = m.stripes[index];
+   int position = (index < m.numOfRows) ? index : index - m.numOfRows; //in the crossing stripes
+   for(size_t i = 0; i < r->changes.size(); i++)
+   {
+      int crossing = crossingStripe(m, index, r->changes[i]);
+      m.dirty.push(crossing);
+      m.stripes[crossing]->noteChange(position);
+      r->noteChange(r->changes[i]);
+   }
+   r->changes.clear();
+}
+
+//Everything left over from a propagation that hit a contradiction
+//is stale once the trail has put the board back, and so are the
+//change logs, which don't know which cells it put back.
+inline void clearPendingWork(RowManager &m)
+{
+   while(!m.dirty.isEmpty())
+      m.dirty.pop();
+   for(size_t i = 0; i < m.stripes.size(); i++)
+   {
+      m.stripes[i]->changes.clear();
+      m.stripes[i]->modified = false;
+      m.stripes[i]->dropLog();
+   }
+}
+
+//Put every stripe on the queue; every stripe has to be
+//checked at least once, even the ones with no clues,
+//since those are the ones that empty their cells.
+inline void initSchedule(RowManager &m)
+{
+   int total = m.numOfRows + m.numOfCols;
+   m.dirty.reset(total);
+   m.numUnsolved = 0;
+   m.checkCount = 0;
+   m.checksSaved = 0;
+   m.guessCount = 0;
+   m.probeCount = 0;
+   m.probedCells = 0;
+   m.exhausted = BUDGET_NONE;
+   m.steals = 0;
+   m.searchTime = 0;
+   m.idleTime = 0;
+   for(int i = 0; i < total; i++)
+   {
+      m.dirty.push(i);
+      m.stripes[i]->dropLog();
+      if(!(m.stripes[i]->isFinal()))
+         m.numUnsolved++;
+   }
+}
+
+//Check stripes until nothing is left on the queue,
+//or until a stripe turns out to contradict its clues.
+//The clock is looked at every 64 stripes, if there is a deadline,
+//and the number of checks made before every one, if there is a limit.
+//The work is counted in passes: a pass is whatever was
+//on the queue when the pass started. The old round-robin
+//order checked every unsolved stripe once per pass, so
+//any unsolved stripe left off the queue is a check saved.
+inline PropagateResult propagateSerial(RowManager &m)
+{
+   bool firstPass = true;
+   int pass = 0, untilClock = 0;
+   while(!m.dirty.isEmpty())
+   {
+      int passLength = m.dirty.size();
+      int unsolvedAtStart = m.numUnsolved;
+      int checked = 0;
+      for(int n = 0; n < passLength; n++)
+      {
+         if(pastCheckLimit(m))
+            return PROPAGATE_OUT_OF_TIME;
+         if(m.hasDeadline && --untilClock <= 0)
+         {
+            untilClock = 64;
+            if(pastDeadline(m))
+               return PROPAGATE_OUT_OF_TIME;
+         }
+         int index = m.dirty.pop();
+         NonogramStripe *r = m.stripes[index];
+         bool wasFinal = r->isFinal();
+         if(wasFinal && !firstPass)
+            continue; //every cell of a finished stripe is already decided
+         if(m.trail != NULL)
+            m.trail->save(r);
+         if(!checkStripe(m, r))
+            return PROPAGATE_CONTRADICTION;
+         m.checkCount++;
+         checked++;
+         if(m.log != NULL && m.log->shows(LOG_STEPS))
+            m.log->write(LOG_STEPS, "Step " + to_string(m.checkCount) + ": " + stripeName(m, index));
+         if(!wasFinal && r->isFinal())
+            m.numUnsolved--;
+         //the rules don't always finish a stripe in one go,
+         //so a stripe that changed gets another look itself
+         if(r->modified)
+         {
+            r->modified = false;
+            m.dirty.push(index);
+         }
+         collectChanges(m, index);
+      }
+      if(unsolvedAtStart > checked)
+         m.checksSaved += unsolvedAtStart - checked;
+      firstPass = false;
+      pass++;
+      if(m.log != NULL && m.log->shows(LOG_PASSES))
+         m.log->progress(LOG_PASSES, "Pass " + to_string(pass) + ": checked " + to_string(checked) + " stripes, "
+                         + to_string(m.numUnsolved) + " still unsolved");
+   }
+   return m.numUnsolved == 0 ? PROPAGATE_SOLVED : PROPAGATE_STALLED;
+}
+
+//Rows only write cells that columns read, and the other way around,
+//so all the rows waiting to be checked can be checked at once, and
+//then all the columns. The grid keeps each row's cells in words of
+//their own, so rows never share a word; columns do, 64 to a word,
+//so each job takes every waiting column of one 64-column band.
+//The grid's mirror is the other way around, so when there is one,
+//the rows go in bands of whole multiples of 64 as well.
+//Each job only touches its own stripes' changes and modified flags;
+//the queue is updated afterwards, one stripe at a time.
+inline PropagateResult propagateParallel(RowManager &m)
+{
+   ThreadPool &pool = *m.pool;
+   int total = m.numOfRows + m.numOfCols;
+   int rowBand = max(1, m.numOfRows / (4 * pool.size()));
+   if(m.g->isMirrored())
+      rowBand = (rowBand + 63) / 64 * 64;
+   vector<bool> checkedOnce(total, false);
+   bool rowsTurn = true;
+   int phase = 0;
+   while(!m.dirty.isEmpty())
+   {
+      //a phase can take the checks past the limit by up to a phase's worth
+      if(pastDeadline(m) || pastCheckLimit(m))
+         return PROPAGATE_OUT_OF_TIME;
+      //take this phase's stripes off the queue and sort them into bands
+      int bandSize = rowsTurn ? rowBand : 64;
+      int first = rowsTurn ? 0 : m.numOfRows;
+      int count = rowsTurn ? m.numOfRows : m.numOfCols;
+      vector<vector<int> > bands((count + bandSize - 1) / bandSize);
+      vector<int> otherKind;
+      int phaseSize = 0;
+      while(!m.dirty.isEmpty())
+      {
+         int index = m.dirty.pop();
+         if((index < m.numOfRows) != rowsTurn)
+            otherKind.push_back(index);
+         else if(!checkedOnce[index] || !(m.stripes[index]->isFinal()))
+         {
+            bands[(index - first) / bandSize].push_back(index);
+            phaseSize++;
+         }
+      }
+      for(size_t i = 0; i < otherKind.size(); i++)
+         m.dirty.push(otherKind[i]);
+      rowsTurn = !rowsTurn;
+      if(phaseSize == 0)
+         continue;
+
+      vector<char> wasFinal(total, 0);
+      atomic<bool> contradiction(false);
+      pool.run(bands.size(), [&](int b)
+      {
+         for(size_t i = 0; i < bands[b].size() && !contradiction; i++)
+         {
+            NonogramStripe *r = m.stripes[bands[b][i]];
+            wasFinal[bands[b][i]] = r->isFinal();
+            if(!checkStripe(m, r))
+               contradiction = true;
+         }
+      });
+      if(contradiction)
+         return PROPAGATE_CONTRADICTION;
+
+      for(size_t b = 0; b < bands.size(); b++)
+      {
+         for(size_t i = 0; i < bands[b].size(); i++)
+         {
+            int index = bands[b][i];
+            NonogramStripe *r = m.stripes[index];
+            checkedOnce[index] = true;
+            m.checkCount++;
+            if(!wasFinal[index] && r->isFinal())
+               m.numUnsolved--;
+            if(r->modified)
+            {
+               r->modified = false;
+               m.dirty.push(index);
+            }
+            collectChanges(m, index);
+         }
+      }
+      phase++;
+      if(m.log != NULL && m.log->shows(LOG_PASSES))
+         m.log->progress(LOG_PASSES, "Phase " + to_string(phase) + (rowsTurn ? " (columns)" : " (rows)") + ": checked "
+                         + to_string(phaseSize) + " stripes, " + to_string(m.numUnsolved) + " still unsolved");
+      if(m.log != NULL && m.log->shows(LOG_STEPS))
+         for(size_t b = 0; b < bands.size(); b++)
+            for(size_t i = 0; i < bands[b].size(); i++)
+               m.log->write(LOG_STEPS, "Checked " + stripeName(m, bands[b][i]));
+   }
+   return m.numUnsolved == 0 ? PROPAGATE_SOLVED : PROPAGATE_STALLED;
+}
+
+//Checks stripes until there is nothing left to do, or until the clues
+//turn out to contradict each other. Guesses are always propagated
+//serially, since the trail is not shared between threads.
+inline PropagateResult propagateStripes(RowManager &m)
+{
+   if(m.pool != NULL && m.trail == NULL)
+      return propagateParallel(m);
+   else
+      return propagateSerial(m);
+}
+
+//The same, for callers that would rather catch a contradiction: returns
+//true if the puzzle is solved, false if the solver has stalled (or run out
+//of time), and throws if the clues contradict each other.
+inline bool propagate(RowManager &m)
+{
+   PropagateResult result = propagateStripes(m);
+   if(result == PROPAGATE_CONTRADICTION)
+      throw "Logic error!";
+   return result == PROPAGATE_SOLVED;
+}
+
+#endif
@@ -0,0 +1,300 @@
+//Title: NonogramSearch.h
+//Description: Guessing, for puzzles the line-by-line logic
+//can't finish on its own. When propagation stalls, an undecided
+//cell is filled (and failing that, emptied), propagation runs
+//again, and a contradiction sends the search back to the last
+//guess. Going back uses the trail rather than copies of the board.
+//If the board asks for it, cells are probed (see NonogramProbe.h)
+//each time propagation stalls, before anything is guessed.
+//countSolutions() searches the same way, but goes on past the first
+//solution, to tell a puzzle with one solution from one with more.
+
+#ifndef NONOGRAMSEARCH_H
+#define NONOGRAMSEARCH_H
+
+#include "NonogramLogic.h"
+#include "NonogramLineSolver.h"
+#include "NonogramObjects.h"
+#include "NonogramScheduler.h"
+#include "NonogramLog.h"
+#include "NonogramProbe.h"
+#include <vector>
+#include <string>
+
+using namespace std;
+
+enum SearchResult { SEARCH_SOLVED, SEARCH_CONTRADICTION, SEARCH_OUT_OF_TIME };
+
+//Picks the undecided cell whose row and column have the fewest
+//undecided cells between them: the most constrained crossing,
+//where a guess is most likely to settle things one way or the other.
+//Returns false if every cell has been decided.
+inline bool chooseCell(RowManager &m, int &row, int &column)
+{
+   vector<int> openInColumn(m.numOfCols, 0);
+   vector<int> openInRow(m.numOfRows, 0);
+   for(int i = 0; i < m.numOfRows; i++)
+      for(int j = 0; j < m.numOfCols; j++)
+         if(m.g->cell(i, j) == '-')
+         {
+            openInRow[i]++;
+            openInColumn[j]++;
+         }
+   int best = -1;
+   for(int i = 0; i < m.numOfRows; i++)
+   {
+      if(openInRow[i] == 0)
+         continue;
+      for(int j = 0; j < m.numOfCols; j++)
+      {
+         if(m.g->cell(i, j) != '-')
+            continue;
+         int score = openInRow[i] + openInColumn[j];
+         if(best < 0 || score < best)
+         {
+            best = score;
+            row = i;
+            column = j;
+         }
+      }
+   }
+   return best >= 0;
+}
+
+//A board with every cell decided still has to be checked against the
+//clues, since the rules only look for contradictions they know about.
+inline bool fullBoardIsValid(RowManager &m)
+{
+   for(size_t i = 0; i < m.stripes.size(); i++)
+   {
+      m.trail->save(m.stripes[i]);
+      if(!solveLine(m.stripes[i]))
+         return false;
+   }
+   return true;
+}
+
+inline SearchResult fromPropagation(PropagateResult propagated)
+{
+   if(propagated == PROPAGATE_SOLVED)
+      return SEARCH_SOLVED;
+   else if(propagated == PROPAGATE_OUT_OF_TIME)
+      return SEARCH_OUT_OF_TIME;
+   else
+      return SEARCH_CONTRADICTION;
+}
+
+//The cells, segments and stripes of a board at some point, to be put
+//back on it (or on another board with the same clues) later.
+struct BoardState
+{
+   GameGrid cells;
+   vector<Segment> segments;
+   vector<bool> finalized;
+   int numUnsolved;
+
+   BoardState(RowManager &b) : cells(*b.g), segments(b.segments)
+   {
+      cells.trail = NULL;
+      finalized.resize(b.stripes.size());
+      for(size_t i = 0; i < b.stripes.size(); i++)
+         finalized[i] = b.stripes[i]->getFinalized();
+      numUnsolved = b.numUnsolved;
+   }
+
+   void restore(RowManager &b)
+   {
+      b.g->copyCells(cells);
+      for(size_t k = 0; k < segments.size(); k++)
+         b.segments[k] = segments[k];
+      for(size_t i = 0; i < finalized.size(); i++)
+         b.stripes[i]->setFinalized(finalized[i]);
+      clearPendingWork(b);
+      b.numUnsolved = numUnsolved;
+   }
+};
+
+//Running out of time (or of checks or guesses, if the board has limits
+//on those) takes back every guess on the way out, so that the board is
+//left with only what the clues forced.
+inline SearchResult searchFrom(RowManager &m, Prober *prober)
+{
+   PropagateResult propagated = propagateStripes(m);
+   if(propagated == PROPAGATE_STALLED && prober != NULL)
+      propagated = prober->run();
+   if(propagated != PROPAGATE_STALLED)
+      return fromPropagation(propagated);
+   int row, column;
+   if(!chooseCell(m, row, column))
+      return fullBoardIsValid(m) ? SEARCH_SOLVED : SEARCH_CONTRADICTION;
+   for(int guess = 0; guess < 2; guess++)
+   {
+      if(pastGuessLimit(m))
+         return SEARCH_OUT_OF_TIME;
+      m.trail->mark(m.numUnsolved);
+      m.guessCount++;
+      if(m.log != NULL && m.log->shows(LOG_PASSES))
+         m.log->progress(LOG_PASSES, "Guess " + to_string(m.guessCount) + ": " + (guess == 0 ? "filling" : "emptying")
+                         + " row " + to_string(row) + ", column " + to_string(column) + " at depth " + to_string(m.trail->depth()));
+      SearchResult result = SEARCH_CONTRADICTION;
+      if(guess == 0 ? m.stripes[row]->fill(column) : m.stripes[row]->empty(column))
+      {
+         m.dirty.push(row);
+         collectChanges(m, row);
+         result = searchFrom(m, prober);
+      }
+      if(result == SEARCH_SOLVED)
+         return SEARCH_SOLVED;
+      m.numUnsolved = m.trail->undo(m.g);
+      clearPendingWork(m);
+      if(result == SEARCH_OUT_OF_TIME)
+         return SEARCH_OUT_OF_TIME;
+   }
+   return SEARCH_CONTRADICTION;
+}
+
+//Solves the puzzle from wherever propagation left it, guessing as needed,
+//unless the board's deadline goes by, or it runs through its checks or
+//guesses, first; SEARCH_OUT_OF_TIME is for any of those.
+//The stripes must have been through initSchedule.
+inline SearchResult searchBoard(RowManager &m)
+{
+   //nothing needs undoing before the first guess, so the first
+   //round of propagation runs without a trail (and in parallel,
+   //if the board has a thread pool)
+   PropagateResult propagated = propagateStripes(m);
+   if(propagated != PROPAGATE_STALLED)
+      return fromPropagation(propagated);
+   Trail trail;
+   m.trail = &trail;
+   m.g->trail = trail.cellLog();
+   Prober *prober = m.probing ? new Prober(m) : NULL;
+   SearchResult result = searchFrom(m, prober);
+   delete prober;
+   m.g->trail = NULL;
+   m.trail = NULL;
+   return result;
+}
+
+//The same, returning false if the puzzle has no solution.
+inline bool search(RowManager &m)
+{
+   return searchBoard(m) == SEARCH_SOLVED;
+}
+
+//What countSolutions found: how many solutions, up to the limit, the
+//first of them, and the cells (row, column) the second one has the
+//other way from the first. Those cells are enough to tell the second
+//solution from the first, and to draw it.
+struct SolutionCount
+{
+   int limit, found;
+   BoardState *first;
+   vector<pair<int, int> > witness;
+
+   SolutionCount(int most = 2)
+   {
+      limit = most;
+      found = 0;
+      first = NULL;
+   }
+
+   ~SolutionCount()
+   {
+      delete first;
+   }
+
+   SolutionCount(const SolutionCount&) = delete;
+   SolutionCount& operator=(const SolutionCount&) = delete;
+
+   void add(RowManager &m)
+   {
+      found++;
+      if(first == NULL)
+      {
+         first = new BoardState(m);
+         return;
+      }
+      if(found != 2)
+         return;
+      //the two solutions differ where their filled planes do
+      const uint64_t *a = first->cells.filledPlane(), *b = m.g->filledPlane();
+      int rowWords = m.g->getRowWords();
+      for(int i = 0; i < m.numOfRows; i++)
+         for(int w = 0; w < rowWords; w++)
+            for(uint64_t bits = a[i * rowWords + w] ^ b[i * rowWords + w]; bits != 0; bits &= bits - 1)
+               witness.push_back(make_pair(i, w * 64 + __builtin_ctzll(bits)));
+   }
+};
+
+//searchFrom, except that a solution is counted and the search goes on
+//past it, as if it had been a contradiction, until "limit" of them
+//have been found; then it stops with SEARCH_SOLVED.
+inline SearchResult countFrom(RowManager &m, Prober *prober, SolutionCount &count)
+{
+   PropagateResult propagated = propagateStripes(m);
+   if(propagated == PROPAGATE_STALLED && prober != NULL)
+      propagated = prober->run();
+   if(propagated == PROPAGATE_CONTRADICTION || propagated == PROPAGATE_OUT_OF_TIME)
+      return fromPropagation(propagated);
+   int row, column;
+   if(propagated == PROPAGATE_STALLED && chooseCell(m, row, column))
+   {
+      for(int guess = 0; guess < 2; guess++)
+      {
+         if(pastGuessLimit(m))
+            return SEARCH_OUT_OF_TIME;
+         m.trail->mark(m.numUnsolved);
+         m.guessCount++;
+         SearchResult result = SEARCH_CONTRADICTION;
+         if(guess == 0 ? m.stripes[row]->fill(column) : m.stripes[row]->empty(column))
+         {
+            m.dirty.push(row);
+            collectChanges(m, row);
+            result = countFrom(m, prober, count);
+         }
+         if(result == SEARCH_SOLVED)
+            return SEARCH_SOLVED;
+         m.numUnsolved = m.trail->undo(m.g);
+         clearPendingWork(m);
+         if(result == SEARCH_OUT_OF_TIME)
+            return SEARCH_OUT_OF_TIME;
+      }
+      return SEARCH_CONTRADICTION;
+   }
+   if(propagated == PROPAGATE_STALLED && !fullBoardIsValid(m))
+      return SEARCH_CONTRADICTION;
+   count.add(m);
+   return count.found >= count.limit ? SEARCH_SOLVED : SEARCH_CONTRADICTION;
+}
+
+//Looks for up to count.limit solutions, searching the whole tree if it
+//has to. Returns SEARCH_SOLVED if there is at least one, and leaves the
+//board with the first; SEARCH_CONTRADICTION if there are none; and
+//SEARCH_OUT_OF_TIME, with only what the clues forced on the board, if
+//one of the board's budgets ran out before the search was done.
+//The stripes must have been through initSchedule.
+inline SearchResult countSolutions(RowManager &m, SolutionCount &count)
+{
+   PropagateResult propagated = propagateStripes(m);
+   if(propagated == PROPAGATE_SOLVED)
+      count.add(m);
+   if(propagated != PROPAGATE_STALLED)
+      return fromPropagation(propagated);
+   Trail trail;
+   m.trail = &trail;
+   m.g->trail = trail.cellLog();
+   Prober *prober = m.probing ? new Prober(m) : NULL;
+   SearchResult result = countFrom(m, prober, count);
+   delete prober;
+   m.g->trail = NULL;
+   m.trail = NULL;
+   if(result == SEARCH_OUT_OF_TIME)
+      return SEARCH_OUT_OF_TIME;
+   if(count.first == NULL)
+      return SEARCH_CONTRADICTION;
+   count.first->restore(m);
+   return SEARCH_SOLVED;
+}
+
+#endif
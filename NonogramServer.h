@@ -0,0 +1,471 @@
+//Title: NonogramServer.h
+//Description: Keeps the solver running and answers requests for
+//puzzles, one line each, on stdin or from clients of a Unix domain
+//socket, so that a front end doesn't start a new process for every
+//puzzle. Requests are handed to a fixed pool of workers as soon as
+//they are read, and each answer is written back the moment its puzzle
+//is done, so a client can send any number of requests without waiting
+//and match up the answers by id, which may come back in any order.
+//
+//A request is
+//   solve <id> <deadline> <row clues> | <column clues>
+//where the id is any word the client likes, the deadline is how many
+//milliseconds the puzzle may take from the time its request is read
+//(0 for no limit; time spent waiting for a free worker counts, so a
+//request still waiting when its deadline passes comes back as a timeout
+//with nothing decided), and the clues for each row (and then each column)
+//are separated by '/', with the numbers within a row separated by
+//spaces or commas. An empty row is left empty, or given as 0:
+//   solve 7 500 1 1/2 2/1 1 1/1 1/1 1 | 5/1/1/1/5
+//"quit", or the end of the input, ends the session once every
+//puzzle asked for so far has been answered. A request may be at most
+//maxRequestLength bytes long, and its puzzle no bigger than the
+//loader allows (see maxPuzzleSide and maxPuzzleCells); anything
+//bigger comes back as an error.
+//
+//An answer is one of
+//   <id> solved <ms> <picture>
+//   <id> multiple <ms> <picture>
+//   <id> no-solution <ms>
+//   <id> timeout <ms> <picture>
+//   <id> over-budget <ms> <picture>
+//   <id> bad-clues <what is wrong>
+//   <id> error <what is wrong>
+//where the picture has its rows separated by '/', '#' for a dark
+//cell, '.' for a light one, and (after a timeout) '-' for one that
+//wasn't decided in time (or, after "over-budget", within the checks or
+//guesses the server was started with). "multiple" only comes back from a server
+//started with -unique (or "-solutions n"); the picture is the first
+//solution found.
+
+#ifndef NONOGRAMSERVER_H
+#define NONOGRAMSERVER_H
+
+#include "NonogramSolver.h"
+#include "NonogramThreads.h"
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <exception>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <cstring>
+#include <cerrno>
+#include <csignal>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+using namespace std;
+
+//The longest line read as a request; the rest of a longer one is thrown away.
+const size_t maxRequestLength = 1 << 22;
+
+//One request, as read off its line.
+struct ServerRequest
+{
+   string id;
+   int deadline;
+   vector<vector<int> > rows, columns;
+};
+
+//Reads one stripe's worth of numbers; false if there is anything else in there.
+inline bool parseStripe(const string &text, vector<int> &clues)
+{
+   size_t i = 0;
+   while(i < text.size())
+   {
+      char c = text[i];
+      if(c == ' ' || c == ',' || c == '\t' || c == '\r')
+         i++;
+      else if(c >= '0' && c <= '9')
+      {
+         long long value = 0;
+         while(i < text.size() && text[i] >= '0' && text[i] <= '9')
+         {
+            if(value < 1000000000)
+               value = value * 10 + (text[i] - '0');
+            i++;
+         }
+         clues.push_back((int)min(value, (long long)1000000000));
+      }
+      else
+         return false;
+   }
+   return true;
+}
+
+inline bool parseStripes(const string &text, vector<vector<int> > &stripes)
+{
+   size_t start = 0;
+   while(true)
+   {
+      size_t end = text.find('/', start);
+      stripes.push_back(vector<int>());
+      if(!parseStripe(text.substr(start, end == string::npos ? string::npos : end - start), stripes.back()))
+         return false;
+      if(end == string::npos)
+         return true;
+      start = end + 1;
+   }
+}
+
+//Returns false, with the reason in "error", for a line that isn't a
+//solve request; the id is filled in as soon as it has been read.
+inline bool parseRequest(const string &line, ServerRequest &request, string &error)
+{
+   istringstream in(line);
+   string command;
+   in >> command;
+   request.id = "-";
+   if(command != "solve")
+   {
+      error = "unknown request \"" + command + "\"";
+      return false;
+   }
+   if(!(in >> request.id))
+   {
+      request.id = "-";
+      error = "the request has no id";
+      return false;
+   }
+   if(line.size() > maxRequestLength)
+   {
+      error = "the request is longer than " + to_string(maxRequestLength) + " bytes";
+      return false;
+   }
+   if(!(in >> request.deadline) || request.deadline < 0)
+   {
+      error = "expected a deadline in milliseconds after the id";
+      return false;
+   }
+   string clues;
+   getline(in, clues);
+   size_t bar = clues.find('|');
+   if(bar == string::npos)
+   {
+      error = "expected '|' between the row clues and the column clues";
+      return false;
+   }
+   request.rows.clear();
+   request.columns.clear();
+   if(!parseStripes(clues.substr(0, bar), request.rows) || !parseStripes(clues.substr(bar + 1), request.columns))
+   {
+      error = "the clues may only hold numbers, spaces, commas and '/'";
+      return false;
+   }
+   if(request.rows.size() > (size_t)maxPuzzleSide || request.columns.size() > (size_t)maxPuzzleSide
+      || (long long)request.rows.size() * request.columns.size() > maxPuzzleCells)
+   {
+      error = "the puzzle is too big (at most " + to_string(maxPuzzleSide) + " rows or columns and "
+              + to_string(maxPuzzleCells) + " cells)";
+      return false;
+   }
+   return true;
+}
+
+//The grid, for an answer: rows separated by '/', with '.' for light cells.
+inline string formatPicture(Solver &solver)
+{
+   string picture;
+   picture.reserve(solver.getRows() * (solver.getColumns() + 1));
+   for(int i = 0; i < solver.getRows(); i++)
+   {
+      if(i > 0)
+         picture += '/';
+      for(int j = 0; j < solver.getColumns(); j++)
+      {
+         char c = solver.cell(i, j);
+         picture += (c == ' ') ? '.' : c;
+      }
+   }
+   return picture;
+}
+
+//The grid for a request that never got to be solved: every cell undecided.
+inline string blankPicture(const ServerRequest &request)
+{
+   string picture;
+   for(size_t i = 0; i < request.rows.size(); i++)
+   {
+      if(i > 0)
+         picture += '/';
+      picture += string(request.columns.size(), '-');
+   }
+   return picture;
+}
+
+//Where requests come from and answers go: stdin and stdout, or a socket.
+//Answers are written by the workers as they finish, one whole line at a time.
+class Connection
+{
+   private:
+   int in, out;
+   bool ownsFiles;
+   string buffer;
+   size_t pos;
+   bool skipping; //throwing away the rest of a line that was too long
+   mutex writeLock;
+   mutex pendingLock;
+   condition_variable allAnswered;
+   int pending;
+
+   public:
+   Connection(int input, int output, bool owns) : in(input), out(output), ownsFiles(owns)
+   {
+      pos = 0;
+      skipping = false;
+      pending = 0;
+   }
+
+   ~Connection()
+   {
+      if(ownsFiles)
+      {
+         close(in);
+         if(out != in)
+            close(out);
+      }
+   }
+
+   //The next line of input, without its newline. False at the end of the input.
+   //A line longer than maxRequestLength is cut off just past that, so that
+   //parseRequest turns it down without the whole of it being kept.
+   bool readLine(string &line)
+   {
+      while(true)
+      {
+         size_t newline = buffer.find('\n', pos);
+         if(skipping && newline != string::npos)
+         {
+            skipping = false;
+            pos = newline + 1;
+            continue;
+         }
+         if(skipping)
+            pos = buffer.size();
+         else if(newline != string::npos)
+         {
+            line = buffer.substr(pos, newline - pos);
+            pos = newline + 1;
+            return true;
+         }
+         else if(buffer.size() - pos > maxRequestLength)
+         {
+            line = buffer.substr(pos, maxRequestLength + 1);
+            pos = buffer.size();
+            skipping = true;
+            return true;
+         }
+         buffer.erase(0, pos);
+         pos = 0;
+         char block[65536];
+         ssize_t got = read(in, block, sizeof(block));
+         if(got <= 0)
+         {
+            //a last line with no newline still counts
+            line = skipping ? "" : buffer;
+            buffer.clear();
+            skipping = false;
+            return !line.empty();
+         }
+         buffer.append(block, got);
+      }
+   }
+
+   //Writes a line out whole; a client that has gone away just misses it.
+   void send(const string &line)
+   {
+      string text = line + "\n";
+      lock_guard<mutex> guard(writeLock);
+      size_t done = 0;
+      while(done < text.size())
+      {
+         ssize_t wrote = write(out, text.data() + done, text.size() - done);
+         if(wrote <= 0)
+            return;
+         done += wrote;
+      }
+   }
+
+   void requestStarted()
+   {
+      lock_guard<mutex> guard(pendingLock);
+      pending++;
+   }
+
+   void requestAnswered()
+   {
+      lock_guard<mutex> guard(pendingLock);
+      if(--pending == 0)
+         allAnswered.notify_all();
+   }
+
+   void waitForAnswers()
+   {
+      unique_lock<mutex> guard(pendingLock);
+      allAnswered.wait(guard, [this]{ return pending == 0; });
+   }
+};
+
+class SolverServer
+{
+   private:
+   SolverOptions options;
+   ThreadPool pool;
+   //only so many requests wait for a worker at once, across all connections,
+   //so that a client sending faster than puzzles get solved is held up
+   mutex waitingLock;
+   condition_variable requestDone;
+   int waiting, maxWaiting;
+
+   string answer(const ServerRequest &request, chrono::steady_clock::time_point received)
+   {
+      SolverOptions o = options;
+      if(request.deadline > 0)
+      {
+         chrono::steady_clock::time_point deadline = received + chrono::milliseconds(request.deadline);
+         int left = chrono::duration_cast<chrono::milliseconds>(deadline - chrono::steady_clock::now()).count();
+         if(left <= 0)
+            return request.id + " timeout 0 " + blankPicture(request);
+         //the server's own limit, if it has one, still holds
+         o.timeLimit = (options.timeLimit > 0) ? min(left, options.timeLimit) : left;
+      }
+      chrono::steady_clock::time_point start = chrono::steady_clock::now();
+      Solver solver(o);
+      SolveStatus status = solver.solve(request.rows, request.columns);
+      if(status == SOLVE_BAD_CLUES)
+         return request.id + " bad-clues " + solver.error();
+      ostringstream line;
+      line << request.id << " " << solveStatusNames[status] << " "
+           << chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+      if(status != SOLVE_CONTRADICTION)
+         line << " " << formatPicture(solver);
+      return line.str();
+   }
+
+   public:
+   //The mode, mirror, cache, probing, order and limits in "o" go for every puzzle;
+   //a request's deadline can only shorten the time limit.
+   SolverServer(const SolverOptions &o, int threads) : options(o), pool(threads)
+   {
+      options.pool = NULL;
+      options.log = NULL;
+      waiting = 0;
+      maxWaiting = 4 * pool.size();
+   }
+
+   //Answers requests from the connection until it ends or says "quit",
+   //then waits for the answers still being worked on.
+   void serve(shared_ptr<Connection> connection)
+   {
+      string line;
+      while(connection->readLine(line))
+      {
+         chrono::steady_clock::time_point received = chrono::steady_clock::now();
+         size_t first = line.find_first_not_of(" \t\r");
+         if(first == string::npos)
+            continue;
+         size_t last = line.find_last_not_of(" \t\r");
+         if(line.compare(first, last + 1 - first, "quit") == 0)
+            break;
+         ServerRequest request;
+         string error;
+         if(!parseRequest(line, request, error))
+         {
+            connection->send(request.id + " error " + error);
+            continue;
+         }
+         {
+            unique_lock<mutex> guard(waitingLock);
+            requestDone.wait(guard, [this]{ return waiting < maxWaiting; });
+            waiting++;
+         }
+         connection->requestStarted();
+         pool.submit([this, connection, request, received]()
+         {
+            //a puzzle that can't be solved (out of memory, say) only fails its own request
+            string reply;
+            try
+            {
+               reply = answer(request, received);
+            }
+            catch(const exception &e)
+            {
+               reply = request.id + " error the solver failed: " + e.what();
+            }
+            connection->send(reply);
+            connection->requestAnswered();
+            lock_guard<mutex> guard(waitingLock);
+            waiting--;
+            requestDone.notify_one();
+         });
+      }
+      connection->waitForAnswers();
+   }
+
+   //Serves stdin and stdout until the input ends.
+   int serveStandardInput()
+   {
+      serve(make_shared<Connection>(0, 1, false));
+      return 0;
+   }
+
+   //Listens on a Unix domain socket at "path" and serves each client
+   //on a thread of its own, until the process is stopped.
+   int serveSocket(const string &path)
+   {
+      int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+      sockaddr_un address;
+      memset(&address, 0, sizeof(address));
+      address.sun_family = AF_UNIX;
+      if(listener < 0 || path.size() >= sizeof(address.sun_path))
+      {
+         cerr << "Can't make a socket at " << path << endl;
+         return 1;
+      }
+      strcpy(address.sun_path, path.c_str());
+      unlink(path.c_str()); //left over from an earlier run
+      if(bind(listener, (sockaddr*)&address, sizeof(address)) < 0 || listen(listener, 64) < 0)
+      {
+         cerr << "Can't listen at " << path << ": " << strerror(errno) << endl;
+         close(listener);
+         return 1;
+      }
+      cerr << "Listening at " << path << endl;
+      while(true)
+      {
+         int client = accept(listener, NULL, NULL);
+         if(client < 0)
+         {
+            if(errno == EINTR)
+               continue;
+            cerr << "Can't accept a client: " << strerror(errno) << endl;
+            break;
+         }
+         shared_ptr<Connection> connection = make_shared<Connection>(client, client, true);
+         thread([this, connection]{ serve(connection); }).detach();
+      }
+      close(listener);
+      unlink(path.c_str());
+      return 1;
+   }
+};
+
+//Runs the server on the socket at socketPath, or on stdin and stdout if there is none.
+inline int runServer(const SolverOptions &options, int threads, const string &socketPath)
+{
+   //a client that hangs up shouldn't take the server down with it
+   signal(SIGPIPE, SIG_IGN);
+   SolverServer server(options, threads);
+   if(socketPath.empty())
+      return server.serveStandardInput();
+   else
+      return server.serveSocket(socketPath);
+}
+
+#endif
\ No newline at end of file
@@ -5,18 +5,73 @@
 //puzzle grid, solves the puzzle,
 //and prints the resulting picture to a file
 //or the screen.
+//Run with no puzzle names, it asks for the files it needs.
+//Given puzzle files or directories of them on the command line
+//("-" for stdin), it solves every puzzle in them without asking
+//anything, one puzzle per core at a time, and writes a summary
+//line for each one.
+//With -parallel, puzzles are solved one at a time instead, each
+//one spreading its rows and columns across all the threads, and
+//guessing on all of them at once (see NonogramParallelSearch.h).
+//-nomirror keeps only one copy of the grid, to save memory on very
+//big puzzles at the cost of slower column checks.
+//"-log silent|summary|passes|steps" sets how much progress is reported
+//along the way: a summary by default when asking for files, nothing at
+//all (besides the summary lines) for a batch of puzzles.
+//"-cache n" keeps up to n megabytes of checks that have been made
+//before (see NonogramLineCache.h), shared by every puzzle in the run,
+//and reports at the end how often a check could be played back.
+//With -probe, whenever the logic stalls, cells are tried both ways
+//before anything is guessed (see NonogramProbe.h).
+//With -priority, the stripes waiting to be checked go by how many of
+//their cells have been decided since they went on the queue, most
+//first, instead of in turn (see WorkQueue in NonogramObjects.h).
+//"-solutions n" keeps searching past the first solution until it has
+//found n, or there are no more; -unique is "-solutions 2". A puzzle with
+//more than one comes out "multiple", and the summary gets two more
+//columns: the solutions found, and the cells (row,column, from 0) where
+//the second one differs from the first, whose picture is written.
+//"-format text|bits|pbm|rle" picks how the pictures are written (see
+//NonogramOutput.h), and "-output file" writes all of them, one after
+//another, to one file ("-" for stdout, in which case the summary goes
+//to stderr unless -summary is given) instead of a file for each.
+//With -partial, puzzles that couldn't be solved get their grids written
+//too, with '-' (or gray) for the cells that weren't decided.
+//"-timelimit ms", "-maxchecks n" and "-maxguesses n" bound the work on
+//each puzzle; one that runs out comes out "timeout" or "over-budget",
+//with the cells that were worked out by then.
+//With -serve, it stays running and solves puzzles asked for one line
+//at a time on stdin, or from clients of the Unix domain socket given
+//with -socket, until the input ends (see NonogramServer.h).
+//Built with -DNONOGRAM_RULE_STATS, it writes out how much each logical
+//step did and what it cost, as JSON, to cerr or the file given with -rulestats.
+//Usage: NonogramSolver [-mode rules|final|exact] [-threads n] [-parallel] [-probe] [-priority] [-unique] [-solutions n]
+//          [-nomirror] [-log level] [-cache megabytes] [-out directory] [-summary file]
+//          [-format text|bits|pbm|rle] [-output file] [-partial] [-rulestats file]
+//          [-timelimit ms] [-maxchecks n] [-maxguesses n] puzzles...
+//       NonogramSolver -serve [-socket path] [-mode rules|final|exact] [-threads n]
+//          [-nomirror] [-cache megabytes] [-probe] [-priority] [-unique] [-solutions n]
+//          [-timelimit ms] [-maxchecks n] [-maxguesses n]
 
-#include "NonogramLogic.h"
-#include "NonogramObjects.h"
+#include "NonogramSolver.h"
+#include "NonogramThreads.h"
+#include "NonogramServer.h"
+#include "NonogramOutput.h"
 #include <iostream>
 #include <fstream>
-#include <windows.h>
-#include <conio.h>
 #include <string>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <condition_variable>
+#include <cstdlib>
+#include <filesystem>
 
 using namespace std;
 
-int main()
+//Asks for a clue file, solves it, and asks where to save the picture.
+int runInteractive(SolverOptions options, ThreadPool *pool, LogLevel level)
 {
    //first, find the file that holds the clues
    cout << "Enter the filename for your puzzle's clues: ";
@@ -31,114 +86,392 @@ int main()
       infile.open(filename.c_str());
    }
    
-   //read in the first line; set up the board
-   int numOfRows, numOfColumns;
-   infile >> numOfRows >> numOfColumns;
-   while(infile.get() != '\n');
-   GameGrid g(numOfRows,numOfColumns);
-   RowManager allRows;
-   allRows.numOfRows = numOfRows;
-   allRows.numOfCols = numOfColumns;
-   allRows.stripes.resize(numOfRows + numOfColumns);
-   allRows.numUnsolved = numOfRows + numOfColumns;
-   allRows.g = &g;
-   //read in the clues for each row...
-   int rowCellCount = 0, colCellCount= 0;
-   for(int i = 0; i < numOfRows; i++)
+   ClueReader reader(infile);
+   PuzzleClues clues;
+   if(!reader.next(clues))
    {
-      NonogramRow *r = new NonogramRow(i, numOfColumns, &g);
-      int nextSegmentLength;
-      Segment *nextSegment;
-      while(infile.peek() != '\n')
+      cout << "Something is wrong with the clues, at " << (reader.error().empty() ? "no puzzle found" : reader.error()) << endl;
+      cout << "Please proofread clue file." << endl;
+      return 1;
+   }
+   Logger log(level, cout);
+   options.pool = pool;
+   options.log = &log;
+   Solver solver(options);
+   //Next, solve the puzzle.
+   cout << "Solving..." <<endl;
+   SolveStatus status = solver.solve(clues);
+   log.flush();
+   bool partial = status == SOLVE_OUT_OF_TIME || status == SOLVE_OVER_BUDGET;
+   if(partial)
+      cout << (status == SOLVE_OUT_OF_TIME ? "Ran out of time" : "Ran out of checks or guesses") << " after "
+           << solver.getChecks() << " steps and " << solver.getGuesses() << " guesses; the picture will have '-' for the cells not worked out." << endl;
+   else if(status != SOLVE_SOLVED && status != SOLVE_MULTIPLE)
+   {
+      cout << "Can\'t solve puzzle!" << endl;
+      return 1;
+   }
+   if(options.solutionLimit > 1 && !partial)
+   {
+      if(status == SOLVE_SOLVED)
+         cout << "The puzzle has only one solution." << endl;
+      else
+         cout << "The puzzle has " << (solver.getSolutions() < options.solutionLimit ? "" : "at least ")
+              << solver.getSolutions() << " solutions; the first two differ in " << solver.witness().size()
+              << " cells. Saving the first." << endl;
+   }
+   if(log.shows(LOG_SUMMARY) && !partial)
+   {
+      cout << "Solved in " << solver.getChecks() << " steps";
+      if(solver.getGuesses() > 0)
+         cout << " and " << solver.getGuesses() << " guesses";
+      cout << "." <<endl;
+      if(solver.getProbes() > 0)
+         cout << "Made " << solver.getProbes() << " probes, which decided " << solver.getProbedCells() << " cells." << endl;
+      if(solver.getSearchTime() > 0)
+         cout << "Guessed on " << pool->size() << " threads for " << solver.getSearchTime() * 1e3 << " ms ("
+              << (int)(solver.getGuesses() / solver.getSearchTime()) << " guesses a second), with "
+              << solver.getSteals() << " steals and " << solver.getIdleTime() * 1e3 << " ms idle." << endl;
+      cout << "Skipped " << solver.getChecksSaved() << " checks that the round-robin order would have made." <<endl;
+   }
+   //Finally, print the result to a file.
+   cout << "Enter a file name to save your picture: ";
+   string picname;
+   cin >> picname;
+   solver.printToFile(picname);
+   cout << "All done!" <<endl;
+   return 0;
+}
+
+//How a batch run goes about its puzzles, and where the pictures go:
+//a file for each puzzle, or all of them into one stream if there is one.
+struct BatchSettings
+{
+   SolverOptions options;
+   int threads;
+   bool parallel;
+   LogLevel level;
+   string outDir, summaryName, outputName;
+   PictureFormat format;
+   bool partial; //write out the grids of puzzles that weren't solved, too
+   PictureWriter *stream;
+};
+
+//What happened to one puzzle in a batch run.
+struct BatchResult
+{
+   string file, status;
+   int rows, cols, checks, guesses;
+   double ms;
+   int solutions; //when counting them
+   string witness;
+};
+
+//Solves one puzzle from start to finish with its own board
+//and stripes, so any number of these can run side by side.
+BatchResult solvePuzzle(const PuzzleClues &clues, const string &name, const string &picname,
+                        const BatchSettings &settings, ThreadPool *pool)
+{
+   BatchResult result = { name, "", clues.rows, clues.cols, 0, 0, 0, 0, "" };
+   chrono::steady_clock::time_point start = chrono::steady_clock::now();
+   Logger log(settings.level);
+   SolverOptions options = settings.options;
+   options.pool = pool;
+   options.log = &log;
+   {
+      Solver solver(options);
+      SolveStatus status = solver.solve(clues);
+      result.status = solveStatusNames[status];
+      if(status == SOLVE_SOLVED || status == SOLVE_MULTIPLE || (settings.partial && status != SOLVE_BAD_CLUES))
       {
-         if(infile.peek()<58 && infile.peek()>47)
+         if(settings.stream != NULL)
+            solver.writePicture(*settings.stream, name);
+         else
          {
-            infile >> nextSegmentLength;
-            rowCellCount += nextSegmentLength;
-            nextSegment = new Segment;
-            nextSegment->length = nextSegmentLength;
-            r->add(nextSegment);
-            
+            ofstream picture(picname.c_str(), ios::binary);
+            PictureWriter writer(picture, settings.format, false);
+            solver.writePicture(writer, name);
          }
-         else
-            infile.ignore();
       }
-      infile.ignore();
-      allRows.stripes[i] = r;
+      result.checks = solver.getChecks();
+      result.guesses = solver.getGuesses();
+      result.solutions = solver.getSolutions();
+      const vector<pair<int, int> > &witness = solver.witness();
+      for(size_t c = 0; c < witness.size(); c++)
+         result.witness += (c > 0 ? " " : "") + to_string(witness[c].first) + "," + to_string(witness[c].second);
    }
-   
-   //...followed by the clues for each column
-   infile.ignore();
-   for(int j = 0; j < numOfColumns; j++)
+   result.ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+   if(log.shows(LOG_SUMMARY))
+      log.write(LOG_SUMMARY, name + ": " + result.status + " after " + to_string(result.checks) + " checks and "
+                + to_string(result.guesses) + " guesses, in " + to_string(result.ms) + " ms");
+   return result;
+}
+
+//A puzzle named on the command line, or every file in a directory named there.
+void addPuzzles(const string &path, vector<string> &files)
+{
+   if(filesystem::is_directory(path))
+   {
+      vector<string> found;
+      for(const filesystem::directory_entry &entry : filesystem::directory_iterator(path))
+         if(entry.is_regular_file())
+            found.push_back(entry.path().string());
+      sort(found.begin(), found.end());
+      files.insert(files.end(), found.begin(), found.end());
+   }
+   else
+      files.push_back(path);
+}
+
+//Where the picture for a puzzle goes: next to the puzzle,
+//or in outDir if one was given, as <name>.solution.txt,
+//or <name>.<number>.solution.txt for a file of many puzzles
+//(or .bin, .pbm or .rle instead of .txt, for the other formats).
+string pictureName(const string &filename, const string &outDir, int number, PictureFormat format)
+{
+   filesystem::path p(filename);
+   filesystem::path dir = outDir.empty() ? p.parent_path() : filesystem::path(outDir);
+   string stem = (filename == "-") ? "stdin" : p.stem().string();
+   if(number > 0)
+      stem += "." + to_string(number);
+   return (dir / (stem + ".solution" + pictureExtensions[format])).string();
+}
+
+int runBatch(const vector<string> &paths, BatchSettings settings)
+{
+   vector<string> files;
+   for(size_t i = 0; i < paths.size(); i++)
+      addPuzzles(paths[i], files);
+   const string &outDir = settings.outDir;
+   if(!outDir.empty())
+      filesystem::create_directories(outDir);
+   ofstream summaryFile;
+   if(!settings.summaryName.empty())
+      summaryFile.open(settings.summaryName.c_str());
+   //"-" sends the pictures to stdout, so without -summary the summary goes to stderr
+   ostream &summary = !settings.summaryName.empty() ? summaryFile
+                      : settings.outputName == "-" ? cerr : cout;
+   ofstream outputFile;
+   settings.stream = NULL;
+   if(settings.outputName == "-")
+      settings.stream = new PictureWriter(cout, settings.format, true);
+   else if(!settings.outputName.empty())
+   {
+      outputFile.open(settings.outputName.c_str(), ios::binary);
+      settings.stream = new PictureWriter(outputFile, settings.format, true);
+   }
+   bool counting = settings.options.solutionLimit > 1;
+   summary << "puzzle\trows\tcols\tstatus\tchecks\tguesses\tms" << (counting ? "\tsolutions\twitness" : "") << endl;
+
+   mutex summaryLock;
+   int failures = 0, reported = 0;
+   auto report = [&](const BatchResult &r)
    {
-      NonogramColumn *c = new NonogramColumn(numOfRows, j, &g);
-      int nextSegmentLength;
-      Segment *nextSegment;
-      while(infile.peek() != '\n'&& !infile.eof())
+      lock_guard<mutex> guard(summaryLock);
+      summary << r.file << "\t" << r.rows << "\t" << r.cols << "\t" << r.status << "\t"
+              << r.checks << "\t" << r.guesses << "\t" << r.ms;
+      if(counting)
+         summary << "\t" << r.solutions << "\t" << r.witness;
+      summary << "\n";
+      reported++;
+      if(r.status != "solved")
+         failures++;
+   };
+   //Puzzles are read here, one after another, and handed to the pool
+   //as they come; only so many wait their turn at once, so that a
+   //huge archive of puzzles doesn't have to fit in memory.
+   ThreadPool pool(settings.threads);
+   mutex waitingLock;
+   condition_variable puzzleDone;
+   int waiting = 0, maxWaiting = 4 * pool.size();
+   for(size_t i = 0; i < files.size(); i++)
+   {
+      string filename = files[i];
+      ifstream infile;
+      if(filename != "-")
+         infile.open(filename.c_str());
+      if(filename != "-" && !infile)
       {
-         if(infile.peek()<58 && infile.peek()>47)
+         BatchResult r = { filename, "unreadable", 0, 0, 0, 0, 0, 0, "" };
+         report(r);
+         continue;
+      }
+      ClueReader reader(filename == "-" ? cin : infile);
+      PuzzleClues clues;
+      int number = 0;
+      while(reader.next(clues))
+      {
+         number++;
+         bool numbered = number > 1 || !reader.atEnd();
+         string name = numbered ? filename + ":" + to_string(number) : filename;
+         string picname = pictureName(filename, outDir, numbered ? number : 0, settings.format);
+         if(settings.parallel)
+            report(solvePuzzle(clues, name, picname, settings, &pool));
+         else
          {
-            infile >> nextSegmentLength;
-            colCellCount += nextSegmentLength;
-            nextSegment = new Segment;
-            nextSegment->length = nextSegmentLength;
-            c->add(nextSegment);
-            
+            {
+               unique_lock<mutex> guard(waitingLock);
+               puzzleDone.wait(guard, [&]{ return waiting < maxWaiting; });
+               waiting++;
+            }
+            pool.submit([&, clues, name, picname]()
+            {
+               report(solvePuzzle(clues, name, picname, settings, NULL));
+               lock_guard<mutex> guard(waitingLock);
+               waiting--;
+               puzzleDone.notify_one();
+            });
          }
-         else
-            infile.ignore();
       }
-      infile.ignore();
-      allRows.stripes[numOfRows + j] = c;
+      if(!reader.error().empty() || number == 0)
+      {
+         string name = (number == 0) ? filename : filename + ":" + to_string(number + 1);
+         BatchResult r = { name, "bad-clues", 0, 0, 0, 0, 0, 0, "" };
+         report(r);
+         cerr << filename << ": " << (number == 0 && reader.error().empty() ? "no puzzles found" : reader.error()) << endl;
+      }
    }
-   if(rowCellCount != colCellCount)
+   pool.wait();
+   delete settings.stream;
+   summary.flush();
+   cerr << reported - failures << " of " << reported << (counting ? " puzzles have only one solution." : " puzzles solved.") << endl;
+   return failures == 0 ? 0 : 1;
+}
+
+int main(int argc, char *argv[])
+{
+   //"-mode rules", "-mode final" or "-mode exact" picks how each stripe is checked
+   CheckMode mode = RULES_ONLY;
+   int threads = 0, cacheMB = 0, solutionLimit = 1, timeLimit = 0, checkLimit = 0, guessLimit = 0;
+   bool parallel = false, mirror = true, levelGiven = false, serve = false, probe = false, byPriority = false;
+   LogLevel level = LOG_SILENT;
+   string outDir, summaryName, ruleStatsName, socketPath, outputName;
+   PictureFormat format = PICTURE_TEXT;
+   bool partial = false;
+   vector<string> puzzles;
+   for(int i = 1; i < argc; i++)
    {
-      cout << "Number of dark cells by row and by column" << endl;
-      cout << "are unequal!! Please proofread clue file.";
+      string arg = argv[i];
+      if(arg == "-mode" && i + 1 < argc)
+      {
+         string name = argv[++i];
+         if(name == "final")
+            mode = RULES_THEN_LINE_SOLVER;
+         else if(name == "exact")
+            mode = LINE_SOLVER_ONLY;
+         else if(name != "rules")
+            cerr << "Unknown mode " << name << "; use rules, final or exact." << endl;
+      }
+      else if(arg == "-threads" && i + 1 < argc)
+         threads = atoi(argv[++i]);
+      else if(arg == "-parallel")
+         parallel = true;
+      else if(arg == "-nomirror")
+         mirror = false;
+      else if(arg == "-probe")
+         probe = true;
+      else if(arg == "-priority")
+         byPriority = true;
+      else if(arg == "-unique")
+         solutionLimit = 2;
+      else if(arg == "-solutions" && i + 1 < argc)
+         solutionLimit = max(atoi(argv[++i]), 1);
+      else if(arg == "-timelimit" && i + 1 < argc)
+         timeLimit = max(atoi(argv[++i]), 0);
+      else if(arg == "-maxchecks" && i + 1 < argc)
+         checkLimit = max(atoi(argv[++i]), 0);
+      else if(arg == "-maxguesses" && i + 1 < argc)
+         guessLimit = max(atoi(argv[++i]), 0);
+      else if(arg == "-log" && i + 1 < argc)
+      {
+         if(parseLogLevel(argv[++i], level))
+            levelGiven = true;
+         else
+            cerr << "Unknown log level " << argv[i] << "; use silent, summary, passes or steps." << endl;
+      }
+      else if(arg == "-serve")
+         serve = true;
+      else if(arg == "-socket" && i + 1 < argc)
+         socketPath = argv[++i];
+      else if(arg == "-cache" && i + 1 < argc)
+         cacheMB = atoi(argv[++i]);
+      else if(arg == "-out" && i + 1 < argc)
+         outDir = argv[++i];
+      else if(arg == "-format" && i + 1 < argc)
+      {
+         if(!parsePictureFormat(argv[++i], format))
+            cerr << "Unknown picture format " << argv[i] << "; use text, bits, pbm or rle." << endl;
+      }
+      else if(arg == "-output" && i + 1 < argc)
+         outputName = argv[++i];
+      else if(arg == "-partial")
+         partial = true;
+      else if(arg == "-summary" && i + 1 < argc)
+         summaryName = argv[++i];
+      else if(arg == "-rulestats" && i + 1 < argc)
+         ruleStatsName = argv[++i];
+      else
+         puzzles.push_back(arg);
    }
-   //Next, solve the puzzle.
-   else
+   
+   LineCache *cache = NULL;
+   if(cacheMB > 0)
+      cache = new LineCache((size_t)cacheMB << 20);
+   SolverOptions options;
+   options.mode = mode;
+   options.mirror = mirror;
+   options.cache = cache;
+   options.probe = probe;
+   options.byPriority = byPriority;
+   options.solutionLimit = solutionLimit;
+   options.timeLimit = timeLimit;
+   options.checkLimit = checkLimit;
+   options.guessLimit = guessLimit;
+   int status;
+   if(serve)
+      status = runServer(options, threads, socketPath);
+   else if(puzzles.empty())
    {
-      cout << "Solving..." <<endl;
-      int stepcount = 0;
-      allRows.nextToCheck = 0;
-      while(allRows.numUnsolved > 0)
+      if(!levelGiven)
+         level = LOG_SUMMARY;
+      if(!parallel)
+         status = runInteractive(options, NULL, level);
+      else
       {
-         //fetch a row to check, then check it
-         NonogramStripe *r = allRows.stripes[allRows.nextToCheck];
-         check(r);
-         if(allRows.stripes[allRows.nextToCheck]->isFinal())
-            allRows.numUnsolved--;
-         //make sure solver is making progress
-         if(stepcount==0 || r->modified)
-         {
-            r->modified = false;
-            allRows.lastModified = allRows.nextToCheck; //i.e. index of r
-         }
-         else if(allRows.lastModified == allRows.nextToCheck)//program has checked every row without modifying anything
-         {
-            cout << "Can\'t solve puzzle!";
-            _getch();
-         }
-         //then iterate to the next row to be checked
-         if(allRows.numUnsolved > 0)
-         {
-            do{
-               if(allRows.nextToCheck == numOfRows + numOfColumns - 1)
-                  allRows.nextToCheck = 0;
-               else
-                  allRows.nextToCheck++;
-            }while(allRows.stripes[allRows.nextToCheck]->isFinal());
-         }
-         stepcount++;
-         cout << "Step " << stepcount << endl;
+         ThreadPool pool(threads);
+         status = runInteractive(options, &pool, level);
       }
-      cout << "Solved in " << stepcount << " steps." <<endl;
-      //Finally, print the result to a file.
-      cout << "Enter a file name to save your picture: ";
-      string picname;
-      cin >> picname;
-      g.printToFile(picname);
-      cout << "All done!" <<endl;
    }
-}
\ No newline at end of file
+   else
+   {
+      BatchSettings settings;
+      settings.options = options;
+      settings.threads = threads;
+      settings.parallel = parallel;
+      settings.level = level;
+      settings.outDir = outDir;
+      settings.summaryName = summaryName;
+      settings.outputName = outputName;
+      settings.format = format;
+      settings.partial = partial;
+      status = runBatch(puzzles, settings);
+   }
+   if(cache != NULL)
+   {
+      cache->printStats(cerr);
+      delete cache;
+   }
+#ifdef NONOGRAM_RULE_STATS
+   if(ruleStatsName.empty())
+      dumpRuleStats(cerr);
+   else
+   {
+      ofstream ruleStatsFile(ruleStatsName.c_str());
+      dumpRuleStats(ruleStatsFile);
+   }
+#else
+   if(!ruleStatsName.empty())
+      cerr << "This build doesn't count the logical steps; rebuild with -DNONOGRAM_RULE_STATS." << endl;
+#endif
+   return status;
+}
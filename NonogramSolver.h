@@ -0,0 +1,323 @@
+//Title: NonogramSolver.h
+//Description: The solver as a class, for programs that would rather
+//solve puzzles themselves than run NonogramSolver on files. A Solver
+//takes its clues from memory, owns the board and stripes it builds
+//for a puzzle and frees them when it moves on to the next one (or goes
+//away), and keeps nothing in common with other Solvers, so any number
+//of them can run at the same time on different threads. A thread pool,
+//line cache or log handed to several Solvers is shared on purpose;
+//each of those is safe to share.
+//Everything in the headers is inline, so this one can be included
+//from any number of a program's files (see NonogramLinkCheck.cpp).
+
+#ifndef NONOGRAMSOLVER_H
+#define NONOGRAMSOLVER_H
+
+#include "NonogramLogic.h"
+#include "NonogramObjects.h"
+#include "NonogramScheduler.h"
+#include "NonogramLoader.h"
+#include "NonogramSearch.h"
+#include "NonogramParallelSearch.h"
+#include "NonogramLog.h"
+#include "NonogramLineCache.h"
+#include "NonogramOutput.h"
+#include <string>
+#include <vector>
+#include <sstream>
+
+using namespace std;
+
+//What came of a solve. SOLVE_STALLED only happens with guessing
+//turned off; SOLVE_CONTRADICTION means the clues have no solution.
+//SOLVE_OUT_OF_TIME leaves the grid with whatever the clues forced
+//before the time ran out, and nothing that was guessed, and so does
+//SOLVE_OVER_BUDGET, when it was the limit on checks or guesses.
+//SOLVE_MULTIPLE only happens when solutions are being counted; the
+//grid has the first solution, and witness() says where another differs.
+enum SolveStatus { SOLVE_SOLVED, SOLVE_STALLED, SOLVE_CONTRADICTION, SOLVE_BAD_CLUES, SOLVE_OUT_OF_TIME, SOLVE_MULTIPLE,
+                   SOLVE_OVER_BUDGET };
+
+inline const char *const solveStatusNames[] = { "solved", "stalled", "no-solution", "bad-clues", "timeout", "multiple", "over-budget" };
+
+//How a Solver goes about a puzzle. The pool, cache and log are not the
+//Solver's, and have to last as long as it does.
+struct SolverOptions
+{
+   CheckMode mode;
+   bool mirror; //see GameGrid
+   bool guess; //false stops where the logic stalls, instead of searching
+   bool probe; //tries cells both ways before guessing (see NonogramProbe.h)
+   bool byPriority; //checks the stripes with the most newly decided cells first (see WorkQueue)
+   ThreadPool *pool; //checks rows and columns in parallel phases, and guesses on every thread, if set
+   LineCache *cache;
+   Logger *log;
+   int timeLimit; //in milliseconds from the start of each solve; 0 for none
+   int checkLimit, guessLimit; //the most checks and guesses each solve may make; 0 for no limit
+   //With 2 or more, the search counts solutions up to this many instead
+   //of stopping at the first (see countSolutions), one thread at a time
+   //even with a pool; 2 is enough to tell if a puzzle's solution is unique.
+   int solutionLimit;
+
+   SolverOptions()
+   {
+      mode = RULES_ONLY;
+      mirror = true;
+      guess = true;
+      probe = false;
+      byPriority = false;
+      pool = NULL;
+      cache = NULL;
+      log = NULL;
+      timeLimit = 0;
+      checkLimit = 0;
+      guessLimit = 0;
+      solutionLimit = 1;
+   }
+};
+
+class Solver
+{
+   private:
+   SolverOptions options;
+   RowManager board;
+   bool built;
+   SolveStatus status;
+   string message;
+   int solutions;
+   vector<pair<int, int> > differences;
+
+   void clear()
+   {
+      if(built)
+         freePuzzle(board);
+      built = false;
+      message.clear();
+      solutions = 0;
+      differences.clear();
+   }
+
+   //which status a budget running out comes to
+   SolveStatus outOfBudget()
+   {
+      return board.exhausted == BUDGET_TIME ? SOLVE_OUT_OF_TIME : SOLVE_OVER_BUDGET;
+   }
+
+   SolveStatus badClues(const string &why)
+   {
+      clear();
+      message = why;
+      return status = SOLVE_BAD_CLUES;
+   }
+
+   public:
+   Solver(const SolverOptions &o = SolverOptions()) : options(o)
+   {
+      built = false;
+      status = SOLVE_BAD_CLUES;
+      solutions = 0;
+   }
+
+   ~Solver()
+   {
+      clear();
+   }
+
+   //the board belongs to this Solver alone
+   Solver(const Solver&) = delete;
+   Solver& operator=(const Solver&) = delete;
+
+   //Solves the puzzle. Whatever was left of the last one is freed first.
+   SolveStatus solve(const PuzzleClues &clues)
+   {
+      clear();
+      string why;
+      if(!checkClues(clues, why))
+         return badClues(why);
+      buildPuzzle(clues, board, options.mirror);
+      built = true;
+      board.mode = options.mode;
+      board.pool = options.pool;
+      board.cache = options.cache;
+      board.probing = options.probe;
+      board.dirty.byPriority = options.byPriority;
+      board.log = options.log;
+      board.hasDeadline = options.timeLimit > 0;
+      board.deadline = chrono::steady_clock::now() + chrono::milliseconds(options.timeLimit);
+      board.checkLimit = options.checkLimit;
+      board.guessLimit = options.guessLimit;
+      initSchedule(board);
+      if(options.guess && options.solutionLimit > 1)
+      {
+         SolutionCount count(options.solutionLimit);
+         SearchResult result = countSolutions(board, count);
+         solutions = count.found;
+         differences = count.witness;
+         status = result == SEARCH_OUT_OF_TIME ? outOfBudget()
+                  : solutions == 0 ? SOLVE_CONTRADICTION
+                  : solutions == 1 ? SOLVE_SOLVED : SOLVE_MULTIPLE;
+      }
+      else if(options.guess)
+      {
+         SearchResult result = searchBoardParallel(board);
+         status = result == SEARCH_SOLVED ? SOLVE_SOLVED
+                  : result == SEARCH_OUT_OF_TIME ? outOfBudget() : SOLVE_CONTRADICTION;
+      }
+      else
+      {
+         PropagateResult result = propagateStripes(board);
+         status = result == PROPAGATE_SOLVED ? SOLVE_SOLVED
+                  : result == PROPAGATE_STALLED ? SOLVE_STALLED
+                  : result == PROPAGATE_OUT_OF_TIME ? outOfBudget() : SOLVE_CONTRADICTION;
+      }
+      return status;
+   }
+
+   //The first puzzle in the text, which is laid out like a clue file
+   //(see NonogramLoader.h).
+   SolveStatus solve(const string &text)
+   {
+      istringstream in(text);
+      ClueReader reader(in);
+      PuzzleClues clues;
+      if(!reader.next(clues))
+         return badClues(reader.error().empty() ? "no puzzle found" : reader.error());
+      return solve(clues);
+   }
+
+   //The clues for each row, top to bottom, and for each column, left to
+   //right. An empty list (or a lone 0) is a stripe with no dark cells.
+   SolveStatus solve(const vector<vector<int> > &rowClues, const vector<vector<int> > &columnClues)
+   {
+      PuzzleClues clues;
+      clues.rows = rowClues.size();
+      clues.cols = columnClues.size();
+      clues.line = 0;
+      for(int i = 0; i < clues.rows + clues.cols; i++)
+      {
+         const vector<int> &stripe = (i < clues.rows) ? rowClues[i] : columnClues[i - clues.rows];
+         int count = 0;
+         for(size_t n = 0; n < stripe.size(); n++)
+            if(stripe[n] != 0)
+            {
+               clues.lengths.push_back(stripe[n]);
+               count++;
+            }
+         clues.counts.push_back(count);
+      }
+      return solve(clues);
+   }
+
+   SolveStatus getStatus()
+   {
+      return status;
+   }
+
+   //what was wrong with the clues, after SOLVE_BAD_CLUES
+   const string& error()
+   {
+      return message;
+   }
+
+   int getRows()
+   {
+      return built ? board.numOfRows : 0;
+   }
+
+   int getColumns()
+   {
+      return built ? board.numOfCols : 0;
+   }
+
+   //'#' for a dark cell, ' ' for a light one, '-' for one not decided
+   //(or off the grid, or with no puzzle built)
+   char cell(int row, int column)
+   {
+      if(row < 0 || row >= getRows() || column < 0 || column >= getColumns())
+         return '-';
+      return board.g->cell(row, column);
+   }
+
+   //The grid as it stands, one string per row. After a contradiction,
+   //this is wherever the solver was when it gave up.
+   vector<string> picture()
+   {
+      vector<string> result(getRows(), string(getColumns(), '-'));
+      for(int i = 0; i < getRows(); i++)
+         for(int j = 0; j < getColumns(); j++)
+            result[i][j] = cell(i, j);
+      return result;
+   }
+
+   void printToFile(const string &filename)
+   {
+      if(built)
+         board.g->printToFile(filename);
+   }
+
+   //Adds the grid to a PictureWriter, named and with this solve's status.
+   void writePicture(PictureWriter &writer, const string &name = "")
+   {
+      if(built)
+         writer.write(*board.g, name, solveStatusNames[status]);
+   }
+
+   int getChecks()
+   {
+      return built ? board.checkCount : 0;
+   }
+
+   int getChecksSaved()
+   {
+      return built ? board.checksSaved : 0;
+   }
+
+   int getGuesses()
+   {
+      return built ? board.guessCount : 0;
+   }
+
+   //how many cells were tried, each way counting once, and how many of them had to be one way
+   int getProbes()
+   {
+      return built ? board.probeCount : 0;
+   }
+
+   int getProbedCells()
+   {
+      return built ? board.probedCells : 0;
+   }
+
+   //With a thread pool: how many tasks the threads of the search stole
+   //from each other, and how long, in seconds, the search took and the
+   //threads spent between them waiting for something to do.
+   int getSteals()
+   {
+      return built ? board.steals : 0;
+   }
+
+   double getSearchTime()
+   {
+      return built ? board.searchTime : 0;
+   }
+
+   double getIdleTime()
+   {
+      return built ? board.idleTime : 0;
+   }
+
+   //When counting: how many solutions were found, up to the limit, and
+   //the cells (row, column) where the second one differs from the first.
+   //A timeout can leave a count of 1 without meaning there is only one.
+   int getSolutions()
+   {
+      return solutions;
+   }
+
+   const vector<pair<int, int> >& witness()
+   {
+      return differences;
+   }
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,142 @@
+//Title: NonogramThreads.h
+//Description: A fixed pool of worker threads. Jobs are
+//handed out in the order they were submitted, and wait()
+//blocks until every job handed in so far has finished.
+//run() only waits for its own jobs, so any number of callers
+//can share one pool.
+
+#ifndef NONOGRAMTHREADS_H
+#define NONOGRAMTHREADS_H
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <atomic>
+
+using namespace std;
+
+class ThreadPool
+{
+   private:
+   vector<thread> workers;
+   deque<function<void()> > jobs;
+   mutex lock;
+   condition_variable jobReady, allDone;
+   int running;
+   bool stopping;
+
+   void work()
+   {
+      while(true)
+      {
+         function<void()> job;
+         {
+            unique_lock<mutex> guard(lock);
+            jobReady.wait(guard, [this]{ return stopping || !jobs.empty(); });
+            if(jobs.empty())
+               return; //only happens once we are stopping
+            job = jobs.front();
+            jobs.pop_front();
+            running++;
+         }
+         job();
+         {
+            lock_guard<mutex> guard(lock);
+            running--;
+            if(running == 0 && jobs.empty())
+               allDone.notify_all();
+         }
+      }
+   }
+
+   public:
+   //a size of 0 means one thread per core
+   ThreadPool(int size = 0)
+   {
+      if(size <= 0)
+         size = thread::hardware_concurrency();
+      if(size <= 0)
+         size = 1;
+      running = 0;
+      stopping = false;
+      for(int i = 0; i < size; i++)
+         workers.push_back(thread(&ThreadPool::work, this));
+   }
+
+   ~ThreadPool()
+   {
+      {
+         lock_guard<mutex> guard(lock);
+         stopping = true;
+      }
+      jobReady.notify_all();
+      for(size_t i = 0; i < workers.size(); i++)
+         workers[i].join();
+   }
+
+   int size()
+   {
+      return workers.size();
+   }
+
+   void submit(function<void()> job)
+   {
+      {
+         lock_guard<mutex> guard(lock);
+         jobs.push_back(job);
+      }
+      jobReady.notify_one();
+   }
+
+   void wait()
+   {
+      unique_lock<mutex> guard(lock);
+      allDone.wait(guard, [this]{ return running == 0 && jobs.empty(); });
+   }
+
+   //Runs job(0) through job(count-1) across the pool and waits for all of
+   //them, and only them. The calling thread takes jobs off the batch
+   //too, and the pool's threads help as they come free, so a run still
+   //finishes when every thread is busy with someone else's work, or
+   //when it is called from one of the pool's own jobs.
+   void run(int count, function<void(int)> job)
+   {
+      struct Batch
+      {
+         function<void(int)> job;
+         int count, done;
+         atomic<int> next;
+         mutex lock;
+         condition_variable finished;
+      };
+      shared_ptr<Batch> batch = make_shared<Batch>();
+      batch->job = job;
+      batch->count = count;
+      batch->done = 0;
+      batch->next = 0;
+      //a helper that comes free after the batch is done finds nothing left, and
+      //the batch lasts as long as it does
+      function<void()> help = [batch]
+      {
+         int i;
+         while((i = batch->next++) < batch->count)
+         {
+            batch->job(i);
+            lock_guard<mutex> guard(batch->lock);
+            if(++batch->done == batch->count)
+               batch->finished.notify_all();
+         }
+      };
+      for(int i = 1; i < count && i < size(); i++)
+         submit(help);
+      help();
+      unique_lock<mutex> guard(batch->lock);
+      batch->finished.wait(guard, [&batch]{ return batch->done == batch->count; });
+   }
+};
+
+#endif